@@ -53,6 +53,9 @@ static const AVOption options[] = {
     { "ibias", "intra quant bias",
         offsetof(DNXHDEncContext, intra_quant_bias), AV_OPT_TYPE_INT,
         { .i64 = 0 }, INT_MIN, INT_MAX, VE },
+    { "rc_tolerance", "keep the previous qscale if it leaves at most this percentage of the frame unused",
+        offsetof(DNXHDEncContext, rc_tolerance), AV_OPT_TYPE_FLOAT,
+        { .dbl = 0 }, 0, 100, VE },
     { "profile",       NULL, offsetof(DNXHDEncContext, profile), AV_OPT_TYPE_INT,
         { .i64 = AV_PROFILE_DNXHD },
         AV_PROFILE_DNXHD, AV_PROFILE_DNXHR_444, VE, .unit = "profile" },
@@ -116,8 +119,9 @@ void dnxhd_10bit_get_pixels_8x4_sym(int16_t *restrict block,
     memcpy(block + 4 * 8, pixels + 3 * line_size, 8 * sizeof(*block));
 }
 
-static int dnxhd_10bit_dct_quantize_444(MPVEncContext *ctx, int16_t *block,
-                                        int n, int qscale, int *overflow)
+/* The 10-bit quantizers take DCT coefficients, see DNXHDEncContext.coefs. */
+static int dnxhd_10bit_quantize_444(MPVEncContext *ctx, int16_t *block,
+                                    int n, int qscale, int *overflow)
 {
     int i, j, level, last_non_zero, start_i;
     const int *qmat;
@@ -126,8 +130,6 @@ static int dnxhd_10bit_dct_quantize_444(MPVEncContext *ctx, int16_t *block,
     int max = 0;
     unsigned int threshold1, threshold2;
 
-    ctx->fdsp.fdct(block);
-
     block[0] = (block[0] + 2) >> 2;
     start_i = 1;
     last_non_zero = 0;
@@ -175,16 +177,14 @@ static int dnxhd_10bit_dct_quantize_444(MPVEncContext *ctx, int16_t *block,
     return last_non_zero;
 }
 
-static int dnxhd_10bit_dct_quantize(MPVEncContext *ctx, int16_t *block,
-                                    int n, int qscale, int *overflow)
+static int dnxhd_10bit_quantize(MPVEncContext *ctx, int16_t *block,
+                                int n, int qscale, int *overflow)
 {
     const uint8_t *scantable = ctx->c.intra_scantable.scantable;
     const int *qmat = n<4 ? ctx->q_intra_matrix[qscale] : ctx->q_chroma_intra_matrix[qscale];
     int last_non_zero = 0;
     int i;
 
-    ctx->fdsp.fdct(block);
-
     // Divide by 4 with rounding, to compensate scaling of DCT coefficients
     block[0] = (block[0] + 2) >> 2;
 
@@ -429,11 +429,11 @@ static av_cold int dnxhd_encode_init(AVCodecContext *avctx)
         ff_videodsp_init(&ctx->m.c.vdsp, ctx->bit_depth);
 
     if (ctx->is_444 || ctx->profile == AV_PROFILE_DNXHR_HQX) {
-        ctx->m.dct_quantize     = dnxhd_10bit_dct_quantize_444;
+        ctx->m.dct_quantize     = dnxhd_10bit_quantize_444;
         ctx->get_pixels_8x4_sym = dnxhd_10bit_get_pixels_8x4_sym;
         ctx->block_width_l2     = 4;
     } else if (ctx->bit_depth == 10) {
-        ctx->m.dct_quantize     = dnxhd_10bit_dct_quantize;
+        ctx->m.dct_quantize     = dnxhd_10bit_quantize;
         ctx->get_pixels_8x4_sym = dnxhd_10bit_get_pixels_8x4_sym;
         ctx->block_width_l2     = 4;
     } else {
@@ -491,7 +491,12 @@ static av_cold int dnxhd_encode_init(AVCodecContext *avctx)
     if (!FF_ALLOCZ_TYPED_ARRAY(ctx->slice_size, ctx->m.c.mb_height) ||
         !FF_ALLOCZ_TYPED_ARRAY(ctx->slice_offs, ctx->m.c.mb_height) ||
         !FF_ALLOCZ_TYPED_ARRAY(ctx->mb_bits,    ctx->m.c.mb_num)    ||
-        !FF_ALLOCZ_TYPED_ARRAY(ctx->mb_qscale,  ctx->m.c.mb_num))
+        !FF_ALLOCZ_TYPED_ARRAY(ctx->mb_qscale,  ctx->m.c.mb_num)    ||
+        !FF_ALLOCZ_TYPED_ARRAY(ctx->qscale_done, avctx->qmax + 1))
+        return AVERROR(ENOMEM);
+
+    if (ctx->bit_depth == 10 &&
+        !FF_ALLOC_TYPED_ARRAY(ctx->coefs, (size_t)ctx->m.c.mb_num * (8 + 4 * ctx->is_444)))
         return AVERROR(ENOMEM);
 
     if (avctx->active_thread_type == FF_THREAD_SLICE) {
@@ -671,6 +676,40 @@ int dnxhd_calc_ac_bits(DNXHDEncContext *ctx, int16_t *block, int last_index)
     return bits;
 }
 
+/**
+ * Bits of the AC coefficients of a block as quantized by the 10-bit
+ * quantizers, computed from the DCT coefficients without storing the
+ * quantized block.
+ */
+static av_always_inline
+int dnxhd_10bit_calc_ac_bits(DNXHDEncContext *ctx, const int16_t *coefs,
+                             int n, int qscale)
+{
+    const uint8_t *scantable = ctx->m.c.intra_scantable.scantable;
+    const int *qmat = n < 4 ? ctx->m.q_intra_matrix[qscale]
+                            : ctx->m.q_chroma_intra_matrix[qscale];
+    int shift = DNX10BIT_QMAT_SHIFT, bias = 0;
+    int bits = 0, run = 0;
+
+    if (ctx->m.dct_quantize == dnxhd_10bit_quantize_444) {
+        shift = 16;
+        bias  = ctx->m.intra_quant_bias * (1 << (16 - 8));
+    }
+
+    for (int i = 1; i < 64; i++) {
+        int j     = scantable[i];
+        int level = (bias + FFABS(coefs[j] * qmat[j])) >> shift;
+        /* the quantizers store the levels in int16_t */
+        level = (int16_t)(coefs[j] < 0 ? -level : level);
+        if (level) {
+            bits += ctx->vlc_bits[level * (1 << 1) | !!run] + ctx->run_bits[run];
+            run   = 0;
+        } else
+            run++;
+    }
+    return bits;
+}
+
 static av_always_inline
 void dnxhd_get_blocks(DNXHDEncContext *ctx, int mb_x, int mb_y)
 {
@@ -819,6 +858,9 @@ static int dnxhd_calc_bits_thread(AVCodecContext *avctx, void *arg,
     DNXHDEncContext *ctx = avctx->priv_data;
     int mb_y = jobnr;
     int qscale = ctx->qscale;
+    int coefs_done = ctx->coefs_done;
+    int rd = avctx->mb_decision == FF_MB_DECISION_RD || !RC_VARIANCE;
+    int nb_blocks = 8 + 4 * ctx->is_444;
     LOCAL_ALIGNED_16(int16_t, block, [64]);
     ctx = ctx->thread[threadnr];
 
@@ -833,18 +875,33 @@ static int dnxhd_calc_bits_thread(AVCodecContext *avctx, void *arg,
         int dc_bits = 0;
         int i;
 
-        dnxhd_get_blocks(ctx, mb_x, mb_y);
+        if (!ctx->coefs || !coefs_done || rd)
+            dnxhd_get_blocks(ctx, mb_x, mb_y);
 
-        for (i = 0; i < 8 + 4 * ctx->is_444; i++) {
+        for (i = 0; i < nb_blocks; i++) {
             int16_t *src_block = ctx->blocks[i];
             int overflow, nbits, diff, last_index;
             int n = dnxhd_switch_matrix(ctx, i);
+            int qmat_n = ctx->is_444 ? 4 * (n > 0): 4 & (2*i);
 
-            memcpy(block, src_block, 64 * sizeof(*block));
-            last_index = ctx->m.dct_quantize(&ctx->m, block,
-                                             ctx->is_444 ? 4 * (n > 0): 4 & (2*i),
-                                             qscale, &overflow);
-            ac_bits   += dnxhd_calc_ac_bits(ctx, block, last_index);
+            int16_t *coefs = NULL;
+
+            if (ctx->coefs) {
+                coefs = ctx->coefs[mb * nb_blocks + i];
+                if (!coefs_done) {
+                    memcpy(coefs, src_block, 64 * sizeof(*block));
+                    ctx->m.fdsp.fdct(coefs);
+                }
+            }
+            if (coefs && !rd) {
+                ac_bits += dnxhd_10bit_calc_ac_bits(ctx, coefs, qmat_n, qscale);
+                block[0] = (coefs[0] + 2) >> 2;
+            } else {
+                memcpy(block, coefs ? coefs : src_block, 64 * sizeof(*block));
+                last_index = ctx->m.dct_quantize(&ctx->m, block, qmat_n,
+                                                 qscale, &overflow);
+                ac_bits   += dnxhd_calc_ac_bits(ctx, block, last_index);
+            }
 
             diff = block[0] - ctx->m.last_dc[n];
             if (diff < 0)
@@ -857,7 +914,7 @@ static int dnxhd_calc_bits_thread(AVCodecContext *avctx, void *arg,
 
             ctx->m.last_dc[n] = block[0];
 
-            if (avctx->mb_decision == FF_MB_DECISION_RD || !RC_VARIANCE) {
+            if (rd) {
                 dnxhd_unquantize_c(ctx, block, i, qscale, last_index);
                 ctx->m.c.idsp.idct(block);
                 ssd += dnxhd_ssd_block(block, src_block);
@@ -891,14 +948,20 @@ static int dnxhd_encode_thread(AVCodecContext *avctx, void *arg,
         put_bits(pb, 11, qscale);
         put_bits(pb, 1, avctx->pix_fmt == AV_PIX_FMT_YUV444P10);
 
-        dnxhd_get_blocks(ctx, mb_x, mb_y);
+        if (!ctx->coefs)
+            dnxhd_get_blocks(ctx, mb_x, mb_y);
 
         for (i = 0; i < 8 + 4 * ctx->is_444; i++) {
             int16_t *block = ctx->blocks[i];
             int overflow, n = dnxhd_switch_matrix(ctx, i);
-            int last_index = ctx->m.dct_quantize(&ctx->m, block,
-                                                 ctx->is_444 ? (((i >> 1) % 3) < 1 ? 0 : 4): 4 & (2*i),
-                                                 qscale, &overflow);
+            int last_index;
+
+            if (ctx->coefs)
+                memcpy(block, ctx->coefs[mb * (8 + 4 * ctx->is_444) + i],
+                       64 * sizeof(*block));
+            last_index = ctx->m.dct_quantize(&ctx->m, block,
+                                             ctx->is_444 ? (((i >> 1) % 3) < 1 ? 0 : 4): 4 & (2*i),
+                                             qscale, &overflow);
 
             dnxhd_encode_block(pb, ctx, block, last_index, n);
         }
@@ -993,16 +1056,25 @@ static int dnxhd_mb_var_thread(AVCodecContext *avctx, void *arg,
     return 0;
 }
 
+/* Fill mb_rc for qscale, unless it was already done for this field. */
+static void dnxhd_calc_bits(DNXHDEncContext *ctx, int qscale)
+{
+    if (ctx->qscale_done[qscale])
+        return;
+    ctx->qscale = qscale;
+    ctx->m.c.avctx->execute2(ctx->m.c.avctx, dnxhd_calc_bits_thread,
+                             NULL, NULL, ctx->m.c.mb_height);
+    ctx->qscale_done[qscale] = 1;
+    ctx->coefs_done = 1;
+}
+
 static int dnxhd_encode_rdo(AVCodecContext *avctx, DNXHDEncContext *ctx)
 {
     int lambda, up_step, down_step;
     int last_lower = INT_MAX, last_higher = 0;
 
-    for (int q = 1; q < avctx->qmax; q++) {
-        ctx->qscale = q;
-        avctx->execute2(avctx, dnxhd_calc_bits_thread,
-                        NULL, NULL, ctx->m.c.mb_height);
-    }
+    for (int q = 1; q < avctx->qmax; q++)
+        dnxhd_calc_bits(ctx, q);
     up_step = down_step = 2 << LAMBDA_FRAC_BITS;
     lambda  = ctx->lambda;
 
@@ -1069,6 +1141,21 @@ static int dnxhd_encode_rdo(AVCodecContext *avctx, DNXHDEncContext *ctx)
     return 0;
 }
 
+static int dnxhd_frame_bits(DNXHDEncContext *ctx, int qscale)
+{
+    int bits = 0;
+
+    dnxhd_calc_bits(ctx, qscale);
+    for (int y = 0; y < ctx->m.c.mb_height; y++) {
+        for (int x = 0; x < ctx->m.c.mb_width; x++)
+            bits += ctx->mb_rc[(qscale*ctx->m.c.mb_num) + (y*ctx->m.c.mb_width+x)].bits;
+        bits = (bits+31)&~31; // padding
+        if (bits > ctx->frame_bits)
+            break;
+    }
+    return bits;
+}
+
 static int dnxhd_find_qscale(DNXHDEncContext *ctx)
 {
     int bits = 0;
@@ -1076,25 +1163,26 @@ static int dnxhd_find_qscale(DNXHDEncContext *ctx)
     int down_step = 1;
     int last_higher = 0;
     int last_lower = INT_MAX;
-    int qscale;
+    int qscale = ctx->qscale;
 
-    qscale = ctx->qscale;
-    for (;;) {
-        bits = 0;
-        ctx->qscale = qscale;
-        // XXX avoid recalculating bits
-        ctx->m.c.avctx->execute2(ctx->m.c.avctx, dnxhd_calc_bits_thread,
-                               NULL, NULL, ctx->m.c.mb_height);
-        for (int y = 0; y < ctx->m.c.mb_height; y++) {
-            for (int x = 0; x < ctx->m.c.mb_width; x++)
-                bits += ctx->mb_rc[(qscale*ctx->m.c.mb_num) + (y*ctx->m.c.mb_width+x)].bits;
-            bits = (bits+31)&~31; // padding
-            if (bits > ctx->frame_bits)
-                break;
+    /* Predict the qscale from the previous field and skip the search if
+     * it does not waste more than the allowed part of the frame. */
+    if (ctx->rc_tolerance > 0 && ctx->fit_qscale) {
+        bits = dnxhd_frame_bits(ctx, ctx->fit_qscale);
+        if (bits < ctx->frame_bits &&
+            ctx->frame_bits - bits <= ctx->frame_bits * ctx->rc_tolerance / 100) {
+            ctx->qscale = ctx->fit_qscale;
+            return 1;
         }
+    }
+
+    for (;;) {
+        bits = dnxhd_frame_bits(ctx, qscale);
         if (bits < ctx->frame_bits) {
-            if (qscale == 1)
+            if (qscale == 1) {
+                ctx->fit_qscale = 1;
                 return 1;
+            }
             if (last_higher == qscale - 1) {
                 qscale = last_higher;
                 break;
@@ -1120,7 +1208,8 @@ static int dnxhd_find_qscale(DNXHDEncContext *ctx)
                 return AVERROR(EINVAL);
         }
     }
-    ctx->qscale = qscale;
+    ctx->qscale     = qscale;
+    ctx->fit_qscale = qscale + 1;
     return 0;
 }
 
@@ -1218,7 +1307,7 @@ retry:
             int rc = (ctx->qscale * ctx->m.c.mb_num ) + mb;
             max_bits -= ctx->mb_rc[rc].bits -
                         ctx->mb_rc[rc + ctx->m.c.mb_num].bits;
-            if (ctx->mb_qscale[mb] < 255)
+            if (ctx->mb_qscale[mb] < avctx->qmax)
                 ctx->mb_qscale[mb]++;
             ctx->mb_bits[mb]   = ctx->mb_rc[rc + ctx->m.c.mb_num].bits;
         }
@@ -1265,6 +1354,9 @@ encode_coding_unit:
 
     dnxhd_write_header(avctx, buf);
 
+    memset(ctx->qscale_done, 0, avctx->qmax + 1);
+    ctx->coefs_done = 0;
+
     if (avctx->mb_decision == FF_MB_DECISION_RD)
         ret = dnxhd_encode_rdo(avctx, ctx);
     else
@@ -1317,6 +1409,8 @@ static av_cold int dnxhd_encode_end(AVCodecContext *avctx)
 
     av_freep(&ctx->mb_bits);
     av_freep(&ctx->mb_qscale);
+    av_freep(&ctx->qscale_done);
+    av_freep(&ctx->coefs);
     av_freep(&ctx->mb_rc);
     av_freep(&ctx->mb_cmp);
     av_freep(&ctx->mb_cmp_tmp);
@@ -96,9 +96,17 @@ typedef struct DNXHDEncContext {
     unsigned slice_bits;
     unsigned qscale;
     unsigned lambda;
+    unsigned fit_qscale;    ///< lowest qscale of the previous field which fit
+    float rc_tolerance;
 
     uint32_t *mb_bits;
-    uint8_t  *mb_qscale;
+    uint16_t *mb_qscale;
+    uint8_t  *qscale_done;  ///< qscales whose bits are in mb_rc for this field
+
+    /* DCT coefficients of the current field, reused for every qscale
+     * tried by the rate control (10-bit only) */
+    int16_t (*coefs)[64];
+    int coefs_done;
 
     RCCMPEntry *mb_cmp;
     RCCMPEntry *mb_cmp_tmp;
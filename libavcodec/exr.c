@@ -278,9 +278,10 @@ static uint16_t reverse_lut(const uint8_t *bitmap, uint16_t *lut)
 {
     int i, k = 0;
 
-    for (i = 0; i < USHORT_RANGE; i++)
-        if ((i == 0) || (bitmap[i >> 3] & (1 << (i & 7))))
-            lut[k++] = i;
+    // value 0 is always present, the bitmap is mostly sparse
+    for (i = 0; i < BITMAP_SIZE; i++)
+        for (unsigned bits = bitmap[i] | !i; bits; bits &= bits - 1)
+            lut[k++] = i * 8 + ff_ctz(bits);
 
     i = k - 1;
 
@@ -1446,7 +1447,11 @@ static int decode_block(AVCodecContext *avctx, void *tdata,
                 if (s->desc->flags & AV_PIX_FMT_FLAG_PLANAR || !c)
                     memset(ptr, 0, bxmin);
 
-                if (s->pixel_type == EXR_FLOAT) {
+                if (!HAVE_BIGENDIAN && step == (s->pixel_type == EXR_HALF ? 2 : 4)) {
+                    // channel lines map to planes, both are little-endian
+                    memcpy(ptr_x, src, xsize * step);
+                    ptr_x += xsize * step;
+                } else if (s->pixel_type == EXR_FLOAT) {
                     // 32-bit
                     for (int x = 0; x < xsize; x++, ptr_x += step)
                         AV_WN32A(ptr_x, bytestream_get_le32(&src));
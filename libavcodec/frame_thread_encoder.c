@@ -164,6 +164,17 @@ av_cold int ff_frame_thread_encoder_init(AVCodecContext *avctx)
         }
     }
 
+    if (avctx->codec_id == AV_CODEC_ID_FFV1 &&
+        (avctx->gop_size > 1 || avctx->flags & AV_CODEC_FLAG_PASS1)) {
+        // only intra-only ffv1 frames are independent of each other,
+        // fall back to slice threading for everything else
+        av_log(avctx, AV_LOG_VERBOSE,
+               "Frame threading is only supported for intra-only (-g 1) "
+               "FFV1 encoding without first pass, using slice threading\n");
+        avctx->thread_type &= ~FF_THREAD_FRAME;
+        return 0;
+    }
+
     if(!avctx->thread_count) {
         avctx->thread_count = av_cpu_count();
         avctx->thread_count = FFMIN(avctx->thread_count, MAX_THREADS);
@@ -2454,6 +2454,11 @@ static void loop_filter(const H264Context *h, H264SliceContext *sl, int start_x,
     if (h->postpone_filter)
         return;
 
+    if (sl->deblock_progress) {
+        sl->deblock_end_x = end_x;
+        return;
+    }
+
     if (sl->deblocking_filter) {
         for (mb_x = start_x; mb_x < end_x; mb_x++)
             for (mb_y = end_mb_y - FRAME_MBAFF(h); mb_y <= end_mb_y; mb_y++) {
@@ -2532,6 +2537,12 @@ static void decode_finish_row(const H264Context *h, H264SliceContext *sl)
     int height         =  16      << FRAME_MBAFF(h);
     int deblock_border = (16 + 4) << FRAME_MBAFF(h);
 
+    if (sl->deblock_progress) {
+        sl->deblock_end_x = 0;
+        ff_thread_progress_report(sl->deblock_progress, sl->mb_y + 1);
+        return;
+    }
+
     if (sl->deblocking_filter) {
         if ((top + height) >= pic_height)
             height += deblock_border;
@@ -2587,7 +2598,7 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
 
     av_assert0(h->block_offset[15] == (4 * ((scan8[15] - scan8[0]) & 7) << h->pixel_shift) + 4 * sl->linesize * ((scan8[15] - scan8[0]) >> 3));
 
-    if (h->postpone_filter)
+    if (h->postpone_filter || sl->deblock_progress)
         sl->deblocking_filter = 0;
 
     sl->is_complex = FRAME_MBAFF(h) || h->picture_structure != PICT_FRAME ||
@@ -2775,6 +2786,92 @@ finish:
     return 0;
 }
 
+/**
+ * Decode the single queued slice while filtering it on a second slice
+ * thread. A MB row is filtered once the row below it has been decoded,
+ * which is done with the unfiltered pixels like with postpone_filter.
+ */
+static int decode_slice_deblock(AVCodecContext *avctx, void *arg,
+                                int jobnr, int threadnr)
+{
+    H264Context *h       = avctx->priv_data;
+    H264SliceContext *sl = &h->slice_ctx[0];
+    H264SliceContext *lf = &h->slice_ctx[1];
+    const int step       = 1 + FIELD_OR_MBAFF_PICTURE(h);
+    int mb_x             = lf->mb_x;
+    int mb_y             = lf->mb_y;
+    int ret;
+
+    if (!jobnr) {
+        ret = decode_slice(avctx, sl);
+        atomic_store_explicit(&h->deblock_done, 1, memory_order_release);
+        ff_thread_progress_report(sl->deblock_progress, INT_MAX);
+        return ret;
+    }
+
+    for (;; mb_y += step, mb_x = 0) {
+        ff_thread_progress_await(&h->deblock_progress, mb_y + step + 1);
+        if (atomic_load_explicit(&h->deblock_done, memory_order_acquire))
+            break;
+        lf->mb_y = mb_y;
+        loop_filter(h, lf, mb_x, h->mb_width);
+        decode_finish_row(h, lf);
+    }
+
+    /* the rows the decoding thread got to, then what it filtered of the
+     * last one when the slice ended inside of it */
+    for (; mb_y < sl->mb_y; mb_y += step, mb_x = 0) {
+        lf->mb_y = mb_y;
+        loop_filter(h, lf, mb_x, h->mb_width);
+        decode_finish_row(h, lf);
+    }
+    if (mb_y == sl->mb_y && sl->deblock_end_x > mb_x) {
+        lf->mb_y = mb_y;
+        loop_filter(h, lf, mb_x, sl->deblock_end_x);
+    }
+
+    return 0;
+}
+
+static int execute_decode_slice_deblock(H264Context *h)
+{
+    H264SliceContext *sl = &h->slice_ctx[0];
+    H264SliceContext *lf = &h->slice_ctx[1];
+    int ret[2] = { 0 };
+
+    lf->slice_num              = sl->slice_num;
+    lf->slice_type             = sl->slice_type;
+    lf->list_count             = sl->list_count;
+    lf->qscale                 = sl->qscale;
+    lf->qp_thresh              = sl->qp_thresh;
+    lf->deblocking_filter      = sl->deblocking_filter;
+    lf->slice_alpha_c0_offset  = sl->slice_alpha_c0_offset;
+    lf->slice_beta_offset      = sl->slice_beta_offset;
+    lf->mb_mbaff               = sl->mb_mbaff;
+    lf->mb_field_decoding_flag = sl->mb_field_decoding_flag;
+    lf->mb_x                   = sl->mb_x;
+    lf->mb_y                   = sl->mb_y;
+    lf->linesize               = h->cur_pic_ptr->f->linesize[0];
+    lf->uvlinesize             = h->cur_pic_ptr->f->linesize[1];
+    lf->deblock_progress       = NULL;
+
+    ret[0] = alloc_scratch_buffers(lf, lf->linesize);
+    if (ret[0] < 0)
+        return ret[0];
+
+    sl->deblock_progress = &h->deblock_progress;
+    sl->deblock_end_x    = 0;
+    ff_thread_progress_reset(&h->deblock_progress);
+    atomic_init(&h->deblock_done, 0);
+
+    h->avctx->execute2(h->avctx, decode_slice_deblock, NULL, ret, 2);
+
+    /* decode_slice() does not restore it on errors */
+    sl->deblocking_filter = lf->deblocking_filter;
+    sl->deblock_progress  = NULL;
+    return ret[0];
+}
+
 /**
  * Call decode_slice() for each context.
  *
@@ -2800,7 +2897,10 @@ int ff_h264_execute_decode_slices(H264Context *h)
         h->slice_ctx[0].next_slice_idx = h->mb_width * h->mb_height;
         h->postpone_filter = 0;
 
-        ret = decode_slice(avctx, &h->slice_ctx[0]);
+        if (h->nb_slice_ctx > 1 && h->slice_ctx[0].deblocking_filter)
+            ret = execute_decode_slice_deblock(h);
+        else
+            ret = decode_slice(avctx, &h->slice_ctx[0]);
         h->mb_y = h->slice_ctx[0].mb_y;
         if (ret < 0)
             goto finish;
@@ -338,6 +338,12 @@ static int h264_init_context(AVCodecContext *avctx, H264Context *h)
     for (i = 0; i < h->nb_slice_ctx; i++)
         h->slice_ctx[i].h264 = h;
 
+    if (h->nb_slice_ctx > 1) {
+        ret = ff_thread_progress_init(&h->deblock_progress, 1);
+        if (ret < 0)
+            return ret;
+    }
+
     return 0;
 }
 
@@ -367,6 +373,7 @@ static av_cold int h264_decode_end(AVCodecContext *avctx)
 
     av_freep(&h->slice_ctx);
     h->nb_slice_ctx = 0;
+    ff_thread_progress_destroy(&h->deblock_progress);
 
     ff_h264_sei_uninit(&h->sei);
     ff_h264_ps_uninit(&h->ps);
@@ -42,6 +42,7 @@
 #include "h264qpel.h"
 #include "mpegutils.h"
 #include "threadframe.h"
+#include "threadprogress.h"
 #include "videodsp.h"
 
 #define H264_MAX_PICTURE_COUNT 36
@@ -194,6 +195,12 @@ typedef struct H264SliceContext {
     int deblocking_filter;          ///< disable_deblocking_filter_idc with 1 <-> 0
     int slice_alpha_c0_offset;
     int slice_beta_offset;
+    /**
+     * If set, the loop filter runs on another thread and the decoded MB
+     * rows are reported to it instead of being filtered.
+     */
+    ThreadProgress *deblock_progress;
+    int deblock_end_x;              ///< end of the last, incomplete MB row to filter
 
     H264PredWeightTable pwt;
 
@@ -372,6 +379,14 @@ typedef struct H264Context {
      */
     int postpone_filter;
 
+    /* Used when a single slice is queued with slice threading: the loop
+     * filter runs on one thread while the slice is decoded on another.
+     * Decoded MB rows are reported to deblock_progress and deblock_done
+     * is set once the decoding thread has returned.
+     */
+    ThreadProgress deblock_progress;
+    atomic_int deblock_done;
+
     /*
      * Set to 1 when the current picture is IDR, 0 otherwise.
      */
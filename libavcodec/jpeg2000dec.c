@@ -62,6 +62,8 @@ enum HT_PLHD_STATUS {
 
 #define HT_MIXED 0x80 // bit 7 of SPcod/SPcoc
 
+#define MAX_CBLK_JOBS 64
+
 
 /* get_bits functions for JPEG2000 packet bitstream
  * It is a get_bit function with a bit-stuffing routine. If the value of the
@@ -2188,7 +2190,6 @@ static void dequantization_int_97(int x, int y, Jpeg2000Cblk *cblk,
     fscale *= (float)(1 << PRESCALE);
     fscale *= (float)(1 << (16 + I_PRESHIFT));
     scale = (int)(fscale + 0.5);
-    band->i_stepsize = scale;
     for (j = 0; j < (cblk->coord[1][1] - cblk->coord[1][0]); ++j) {
         int32_t *datap = &comp->i_data[(comp->coord[0][1] - comp->coord[0][0]) * (y + j) + x];
         int *src = t1->data + j*t1->stride;
@@ -2198,7 +2199,7 @@ static void dequantization_int_97(int x, int y, Jpeg2000Cblk *cblk,
                 val = -(val & INT32_MAX);
             // Shifting down to prevent overflow in dequantization
             val = (val + (1LL << (PRESCALE - 1))) >> PRESCALE;
-            datap[i] = RSHIFT(val * (int64_t)band->i_stepsize, 16);
+            datap[i] = RSHIFT(val * (int64_t)scale, 16);
         }
     }
 }
@@ -2232,11 +2233,21 @@ static inline void mct_decode(const Jpeg2000DecoderContext *s, Jpeg2000Tile *til
 }
 
 
-static inline int tile_codeblocks(const Jpeg2000DecoderContext *s, Jpeg2000Tile *tile)
+/**
+ * Decode and dequantize the codeblocks of a tile, the n-th codeblock is
+ * decoded if n % nb_jobs == jobnr.
+ *
+ * @return bitmask of the components with coded codeblocks, or a negative
+ *         AVERROR
+ */
+static int tile_codeblocks(const Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
+                           int jobnr, int nb_jobs)
 {
     Jpeg2000T1Context t1;
 
     int compno, reslevelno, bandno;
+    int coded_mask = 0;
+    unsigned n = 0;
 
     /* Loop on tile components */
     for (compno = 0; compno < s->ncomponents; compno++) {
@@ -2284,6 +2295,9 @@ static inline int tile_codeblocks(const Jpeg2000DecoderContext *s, Jpeg2000Tile
 
                         Jpeg2000Cblk *cblk = prec->cblk + cblkno;
 
+                        if (n++ % nb_jobs != jobnr)
+                            continue;
+
                         if (cblk->modes & JPEG2000_CTSY_HTJ2K_F)
                             ret = ff_jpeg2000_decode_htj2k(s, codsty, &t1, cblk,
                                                            cblk->coord[0][1] - cblk->coord[0][0],
@@ -2313,12 +2327,19 @@ static inline int tile_codeblocks(const Jpeg2000DecoderContext *s, Jpeg2000Tile
             } /* end band */
         } /* end reslevel */
 
-        /* inverse DWT */
         if (coded)
-            ff_dwt_decode(&comp->dwt, codsty->transform == FF_DWT97 ? (void*)comp->f_data : (void*)comp->i_data);
-
+            coded_mask |= 1 << compno;
     } /*end comp */
-    return 0;
+    return coded_mask;
+}
+
+static void tile_dwt(const Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
+                     int compno)
+{
+    Jpeg2000Component *comp     = tile->comp   + compno;
+    Jpeg2000CodingStyle *codsty = tile->codsty + compno;
+
+    ff_dwt_decode(&comp->dwt, codsty->transform == FF_DWT97 ? (void*)comp->f_data : (void*)comp->i_data);
 }
 
 #define WRITE_FRAME(D, PIXEL)                                                                     \
@@ -2391,17 +2412,9 @@ WRITE_FRAME(16, uint16_t)
 
 #undef WRITE_FRAME
 
-static int jpeg2000_decode_tile(AVCodecContext *avctx, void *td,
-                                int jobnr, int threadnr)
+static void tile_write_frame(const Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
+                             AVFrame *picture)
 {
-    const Jpeg2000DecoderContext *s = avctx->priv_data;
-    AVFrame *picture = td;
-    Jpeg2000Tile *tile = s->tile + jobnr;
-
-    int ret = tile_codeblocks(s, tile);
-    if (ret < 0)
-        return ret;
-
     /* inverse MCT transformation */
     if (tile->codsty[0].mct)
         mct_decode(s, tile);
@@ -2416,10 +2429,82 @@ static int jpeg2000_decode_tile(AVCodecContext *avctx, void *td,
 
         write_frame_16(s, tile, picture, precision);
     }
+}
+
+static int jpeg2000_decode_tile(AVCodecContext *avctx, void *td,
+                                int jobnr, int threadnr)
+{
+    const Jpeg2000DecoderContext *s = avctx->priv_data;
+    AVFrame *picture = td;
+    Jpeg2000Tile *tile = s->tile + jobnr;
 
+    int coded = tile_codeblocks(s, tile, 0, 1);
+    if (coded < 0)
+        return coded;
+
+    for (int compno = 0; compno < s->ncomponents; compno++)
+        if (coded & (1 << compno))
+            tile_dwt(s, tile, compno);
+
+    tile_write_frame(s, tile, picture);
+
+    return 0;
+}
+
+static int decode_codeblocks_job(AVCodecContext *avctx, void *td,
+                                 int jobnr, int threadnr)
+{
+    const Jpeg2000DecoderContext *s = avctx->priv_data;
+
+    return tile_codeblocks(s, td, jobnr, FFMIN(avctx->thread_count, MAX_CBLK_JOBS));
+}
+
+typedef struct TileDWTJob {
+    Jpeg2000Tile *tile;
+    int coded;
+} TileDWTJob;
+
+static int dwt_job(AVCodecContext *avctx, void *td, int jobnr, int threadnr)
+{
+    const Jpeg2000DecoderContext *s = avctx->priv_data;
+    const TileDWTJob *job = td;
+
+    if (job->coded & (1 << jobnr))
+        tile_dwt(s, job->tile, jobnr);
     return 0;
 }
 
+/**
+ * Decode the tiles one after another, with the codeblocks and the inverse
+ * DWT of each component of a tile spread over the slice threads. Used when
+ * there are fewer tiles than threads, e.g. for single tile pictures.
+ */
+static void decode_tiles_cblk_threaded(const Jpeg2000DecoderContext *s, AVFrame *picture)
+{
+    AVCodecContext *avctx = s->avctx;
+    int nb_jobs = FFMIN(avctx->thread_count, MAX_CBLK_JOBS);
+    int ret[MAX_CBLK_JOBS];
+
+    for (int tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++) {
+        TileDWTJob job = { .tile = s->tile + tileno };
+        int err = 0;
+
+        avctx->execute2(avctx, decode_codeblocks_job, job.tile, ret, nb_jobs);
+        for (int i = 0; i < nb_jobs; i++) {
+            if (ret[i] < 0)
+                err = 1;
+            else
+                job.coded |= ret[i];
+        }
+        if (err)
+            continue;
+
+        avctx->execute2(avctx, dwt_job, &job, NULL, s->ncomponents);
+
+        tile_write_frame(s, job.tile, picture);
+    }
+}
+
 static void jpeg2000_dec_cleanup(Jpeg2000DecoderContext *s)
 {
     int tileno, compno;
@@ -2916,7 +3001,11 @@ static int jpeg2000_decode_frame(AVCodecContext *avctx, AVFrame *picture,
         if (++x == s->ncomponents)
             picture->flags |= AV_FRAME_FLAG_LOSSLESS;
 
-    avctx->execute2(avctx, jpeg2000_decode_tile, picture, NULL, s->numXtiles * s->numYtiles);
+    if ((avctx->active_thread_type & FF_THREAD_SLICE) &&
+        s->numXtiles * s->numYtiles < avctx->thread_count)
+        decode_tiles_cblk_threaded(s, picture);
+    else
+        avctx->execute2(avctx, jpeg2000_decode_tile, picture, NULL, s->numXtiles * s->numYtiles);
 
     jpeg2000_dec_cleanup(s);
 
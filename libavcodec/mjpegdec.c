@@ -58,6 +58,8 @@
 
 static void mjpeg_find_raw_scan_data(MJpegDecodeContext *s,
                                      const uint8_t **pbuf_ptr, size_t *pbuf_size);
+static size_t unescape_scan_data(uint8_t *dst, const uint8_t *src,
+                                 const uint8_t *buf_end, const uint8_t **next);
 
 static int init_default_huffman_tables(MJpegDecodeContext *s)
 {
@@ -837,41 +839,43 @@ int ff_mjpeg_decode_sof(MJpegDecodeContext *s)
     return 0;
 }
 
-static inline int mjpeg_decode_dc(MJpegDecodeContext *s, int dc_index, int *val)
+static inline int mjpeg_decode_dc(MJpegDecodeContext *s, GetBitContext *gb,
+                                  int dc_index, int *val)
 {
     int code;
-    code = get_vlc2(&s->gb, s->vlcs[0][dc_index].table, 9, 2);
+    code = get_vlc2(gb, s->vlcs[0][dc_index].table, 9, 2);
     if (code < 0 || code > 16) {
         av_log(s->avctx, AV_LOG_ERROR,
                "mjpeg_decode_dc: bad vlc: %d\n", dc_index);
         return AVERROR_INVALIDDATA;
     }
 
-    *val = code ? get_xbits(&s->gb, code) : 0;
+    *val = code ? get_xbits(gb, code) : 0;
     return 0;
 }
 
 /* decode block and dequantize */
-static int decode_block(MJpegDecodeContext *s, int16_t *block, int component,
+static int decode_block(MJpegDecodeContext *s, GetBitContext *gb,
+                        int16_t *block, int *last_dc,
                         int dc_index, int ac_index, uint16_t *quant_matrix)
 {
     int code, i, j, level, val;
 
     /* DC coef */
-    int ret = mjpeg_decode_dc(s, dc_index, &val);
+    int ret = mjpeg_decode_dc(s, gb, dc_index, &val);
     if (ret < 0)
         return ret;
 
-    val = val * (unsigned)quant_matrix[0] + s->last_dc[component];
-    s->last_dc[component] = val;
+    val = val * (unsigned)quant_matrix[0] + *last_dc;
+    *last_dc = val;
     block[0] = av_clip_int16(val);
     /* AC coefs */
     i = 0;
     {
-        OPEN_READER(re, &s->gb);
+        OPEN_READER(re, gb);
         do {
-            UPDATE_CACHE(re, &s->gb);
-            GET_VLC(code, re, &s->gb, s->vlcs[1][ac_index].table, 9, 2);
+            UPDATE_CACHE(re, gb);
+            GET_VLC(code, re, gb, s->vlcs[1][ac_index].table, 9, 2);
 
             i += ((unsigned)code) >> 4;
             code &= 0xf;
@@ -880,12 +884,12 @@ static int decode_block(MJpegDecodeContext *s, int16_t *block, int component,
                 // So we have at least MIN_CACHE_BITS - 9 > 15 bits left here
                 // and don't need to refill the cache.
                 {
-                    int cache = GET_CACHE(re, &s->gb);
+                    int cache = GET_CACHE(re, gb);
                     int sign  = (~cache) >> 31;
                     level     = (NEG_USR32(sign ^ cache,code) ^ sign) - sign;
                 }
 
-                LAST_SKIP_BITS(re, &s->gb, code);
+                LAST_SKIP_BITS(re, gb, code);
 
                 if (i > 63) {
                     av_log(s->avctx, AV_LOG_ERROR, "error count: %d\n", i);
@@ -895,7 +899,7 @@ static int decode_block(MJpegDecodeContext *s, int16_t *block, int component,
                 block[j] = level * quant_matrix[i];
             }
         } while (i < 63);
-        CLOSE_READER(re, &s->gb);
+        CLOSE_READER(re, gb);
     }
 
     return 0;
@@ -907,7 +911,7 @@ static int decode_dc_progressive(MJpegDecodeContext *s, int16_t *block,
 {
     unsigned val;
     s->bdsp.clear_block(block);
-    int ret = mjpeg_decode_dc(s, dc_index, &val);
+    int ret = mjpeg_decode_dc(s, &s->gb, dc_index, &val);
     if (ret < 0)
         return ret;
 
@@ -1160,7 +1164,7 @@ static int ljpeg_decode_rgb_scan(MJpegDecodeContext *s)
 
                 PREDICT(pred, topleft[i], top[i], left[i], modified_predictor);
 
-                ret = mjpeg_decode_dc(s, s->dc_index[i], &dc);
+                ret = mjpeg_decode_dc(s, &s->gb, s->dc_index[i], &dc);
                 if (ret < 0)
                     return ret;
 
@@ -1289,7 +1293,7 @@ static int ljpeg_decode_yuv_scan(MJpegDecodeContext *s)
                     for (j = 0; j < n; j++) {
                         int pred, dc;
 
-                        ret = mjpeg_decode_dc(s, s->dc_index[i], &dc);
+                        ret = mjpeg_decode_dc(s, &s->gb, s->dc_index[i], &dc);
                         if (ret < 0)
                             return ret;
 
@@ -1361,7 +1365,7 @@ static int ljpeg_decode_yuv_scan(MJpegDecodeContext *s)
                     for (j = 0; j < n; j++) {
                         int pred;
 
-                        ret = mjpeg_decode_dc(s, s->dc_index[i], &dc);
+                        ret = mjpeg_decode_dc(s, &s->gb, s->dc_index[i], &dc);
                         if (ret < 0)
                             return ret;
 
@@ -1427,6 +1431,145 @@ static void shift_output(MJpegDecodeContext *s, uint8_t *ptr, int linesize)
     }
 }
 
+typedef struct ScanThreadContext {
+    uint8_t *data[MAX_COMPONENTS];
+    int linesize[MAX_COMPONENTS];
+    int chroma_width, chroma_height;
+    int nb_segments;
+    int nb_jobs;
+} ScanThreadContext;
+
+static int decode_restart_intervals(AVCodecContext *avctx, void *arg,
+                                    int jobnr, int threadnr)
+{
+    MJpegDecodeContext *s = avctx->priv_data;
+    const ScanThreadContext *st = arg;
+    int nb_mcus = s->mb_width * s->mb_height;
+    int bytes_per_pixel = 1 + (s->bits > 8);
+    int seg_start = (int64_t)jobnr       * st->nb_segments / st->nb_jobs;
+    int seg_end   = (int64_t)(jobnr + 1) * st->nb_segments / st->nb_jobs;
+    LOCAL_ALIGNED_32(int16_t, block, [64]);
+
+    for (int seg = seg_start; seg < seg_end; seg++) {
+        int mcu_end = FFMIN((int64_t)(seg + 1) * s->restart_interval, nb_mcus);
+        int last_dc[MAX_COMPONENTS];
+        GetBitContext gb;
+        int ret;
+
+        ret = init_get_bits8(&gb, s->rst_buffer + s->rst_offsets[seg],
+                             s->rst_offsets[seg + 1] - s->rst_offsets[seg] -
+                             AV_INPUT_BUFFER_PADDING_SIZE);
+        if (ret < 0)
+            return ret;
+        for (int i = 0; i < s->nb_components_sos; i++)
+            last_dc[i] = 4 << s->bits;
+
+        for (int mcu = seg * s->restart_interval; mcu < mcu_end; mcu++) {
+            int mb_x = mcu % s->mb_width;
+            int mb_y = mcu / s->mb_width;
+
+            if (get_bits_left(&gb) < 0) {
+                av_log(avctx, AV_LOG_ERROR, "overread %d\n", -get_bits_left(&gb));
+                return AVERROR_INVALIDDATA;
+            }
+            for (int i = 0; i < s->nb_components_sos; i++) {
+                int c = s->comp_index[i];
+                int h = s->h_scount[i];
+                int v = s->v_scount[i];
+                int x = 0, y = 0;
+
+                for (int j = 0; j < s->nb_blocks[i]; j++) {
+                    int block_offset = (((st->linesize[c] * (v * mb_y + y) * 8) +
+                                         (h * mb_x + x) * 8 * bytes_per_pixel) >> avctx->lowres);
+                    uint8_t *ptr = NULL;
+
+                    if (s->interlaced && s->bottom_field)
+                        block_offset += st->linesize[c] >> 1;
+                    if (   8 * (h * mb_x + x) < ((c == 1) || (c == 2) ? st->chroma_width  : s->width)
+                        && 8 * (v * mb_y + y) < ((c == 1) || (c == 2) ? st->chroma_height : s->height))
+                        ptr = st->data[c] + block_offset;
+
+                    s->bdsp.clear_block(block);
+                    if (decode_block(s, &gb, block, &last_dc[i],
+                                     s->dc_index[i], s->ac_index[i],
+                                     s->quant_matrixes[s->quant_sindex[i]]) < 0) {
+                        av_log(avctx, AV_LOG_ERROR,
+                               "error y=%d x=%d\n", mb_y, mb_x);
+                        return AVERROR_INVALIDDATA;
+                    }
+                    if (ptr && st->linesize[c]) {
+                        s->idsp.idct_put(ptr, st->linesize[c], block);
+                        if (s->bits & 7)
+                            shift_output(s, ptr, st->linesize[c]);
+                    }
+                    if (++x == h) {
+                        x = 0;
+                        y++;
+                    }
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Decode a baseline scan with restart markers using slice threads.
+ * The restart intervals are unescaped serially, each followed by zeroed
+ * padding as if it had been unescaped on its own, and then decoded in
+ * parallel, as they do not depend on each other.
+ *
+ * @return 1 if the scan is not suited for threading, 0 or a negative
+ *         AVERROR otherwise
+ */
+static int decode_scan_threaded(MJpegDecodeContext *s, ScanThreadContext *st)
+{
+    AVCodecContext *avctx = s->avctx;
+    const uint8_t *buf_ptr = s->gB.buffer;
+    const uint8_t *buf_end = buf_ptr + bytestream2_get_bytes_left(&s->gB);
+    int64_t nb_mcus = (int64_t)s->mb_width * s->mb_height;
+    int nb_segments;
+    size_t offset = 0;
+
+    if (!(avctx->active_thread_type & FF_THREAD_SLICE) || !s->restart_interval)
+        return 1;
+    nb_segments = (nb_mcus + s->restart_interval - 1) / s->restart_interval;
+    /* A scan with fewer bytes than restart markers is truncated, decode
+     * it serially instead of padding every interval. */
+    if (nb_segments < 2 || nb_segments > (buf_end - buf_ptr) / 2)
+        return 1;
+
+    av_fast_padded_malloc(&s->rst_buffer, &s->rst_buffer_size,
+                          (buf_end - buf_ptr) +
+                          (size_t)nb_segments * AV_INPUT_BUFFER_PADDING_SIZE);
+    av_fast_malloc(&s->rst_offsets, &s->rst_offsets_size,
+                   (nb_segments + 1) * sizeof(*s->rst_offsets));
+    st->nb_jobs = FFMIN(nb_segments, avctx->thread_count * 4);
+    av_fast_malloc(&s->rst_ret, &s->rst_ret_size,
+                   st->nb_jobs * sizeof(*s->rst_ret));
+    if (!s->rst_buffer || !s->rst_offsets || !s->rst_ret)
+        return AVERROR(ENOMEM);
+
+    for (int seg = 0; seg < nb_segments; seg++) {
+        s->rst_offsets[seg] = offset;
+        offset += unescape_scan_data(s->rst_buffer + offset, buf_ptr, buf_end,
+                                     &buf_ptr);
+        memset(s->rst_buffer + offset, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+        offset += AV_INPUT_BUFFER_PADDING_SIZE;
+    }
+    s->rst_offsets[nb_segments] = offset;
+    bytestream2_skipu(&s->gB, buf_ptr - s->gB.buffer);
+
+    st->nb_segments = nb_segments;
+    avctx->execute2(avctx, decode_restart_intervals, st, s->rst_ret, st->nb_jobs);
+    for (int i = 0; i < st->nb_jobs; i++)
+        if (s->rst_ret[i] < 0)
+            return s->rst_ret[i];
+
+    return 0;
+}
+
 static int mjpeg_decode_scan(MJpegDecodeContext *s)
 {
     int nb_components = s->nb_components_sos;
@@ -1472,6 +1615,20 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s)
 next_field:
     s->restart_count = -1;
 
+    if (!s->progressive && !mb_bitmask) {
+        ScanThreadContext st = {
+            .chroma_width  = chroma_width,
+            .chroma_height = chroma_height,
+        };
+        memcpy(st.data,     data,     sizeof(st.data));
+        memcpy(st.linesize, linesize, sizeof(st.linesize));
+        ret = decode_scan_threaded(s, &st);
+        if (ret < 0)
+            return ret;
+        if (!ret)
+            goto field_done;
+    }
+
     for (mb_y = 0; mb_y < s->mb_height; mb_y++) {
         for (mb_x = 0; mb_x < s->mb_width; mb_x++) {
             const int copy_mb = mb_bitmask && !get_bits1(&mb_bitmask_gb);
@@ -1530,7 +1687,7 @@ next_field:
 
                         } else {
                             s->bdsp.clear_block(s->block);
-                            if (decode_block(s, s->block, i,
+                            if (decode_block(s, &s->gb, s->block, &s->last_dc[i],
                                              s->dc_index[i], s->ac_index[i],
                                              s->quant_matrixes[s->quant_sindex[i]]) < 0) {
                                 av_log(s->avctx, AV_LOG_ERROR,
@@ -1571,6 +1728,7 @@ next_field:
         }
     }
 
+field_done:
     if (s->interlaced &&
         bytestream2_get_bytes_left(&s->gB) > 2 &&
         bytestream2_tell(&s->gB) > 2 &&
@@ -2248,6 +2406,60 @@ found_hw:
     bytestream2_skipu(&s->gB, *pbuf_size);
 }
 
+/**
+ * Unescape the entropy-coded data of one restart interval.
+ *
+ * @param dst  buffer of at least end - src bytes
+ * @param next set to the position after the RST marker ending the interval,
+ *             or to the non-restart marker ending the scan
+ * @return size of the unescaped data
+ */
+static size_t unescape_scan_data(uint8_t *dst, const uint8_t *src,
+                                 const uint8_t *buf_end, const uint8_t **next)
+{
+    const uint8_t *ptr = src;
+    PutByteContext pb;
+
+    bytestream2_init_writer(&pb, dst, buf_end - src);
+
+    while ((ptr = memchr(ptr, 0xff, buf_end - ptr))) {
+        ptr++;
+        if (ptr < buf_end) {
+            /* Copy verbatim data. */
+            ptrdiff_t length = (ptr - 1) - src;
+            if (length > 0)
+                bytestream2_put_bufferu(&pb, src, length);
+
+            uint8_t x = *ptr++;
+            /* Discard multiple optional 0xFF fill bytes. */
+            while (x == 0xff && ptr < buf_end)
+                x = *ptr++;
+
+            src = ptr;
+            if (x == 0) {
+                /* Stuffed zero byte */
+                bytestream2_put_byteu(&pb, 0xff);
+            } else if (x >= RST0 && x <= RST7) {
+                /* Restart marker */
+                goto found;
+            } else {
+                /* Non-restart marker */
+                ptr -= 2;
+                goto found;
+            }
+        }
+    }
+    /* Copy remaining verbatim data. */
+    ptr = buf_end;
+    ptrdiff_t length = ptr - src;
+    if (length > 0)
+        bytestream2_put_bufferu(&pb, src, length);
+
+found:
+    *next = ptr;
+    return bytestream2_tell_p(&pb);
+}
+
 int ff_mjpeg_unescape_sos(MJpegDecodeContext *s)
 {
     const uint8_t *buf_ptr = s->gB.buffer;
@@ -2271,49 +2483,10 @@ int ff_mjpeg_unescape_sos(MJpegDecodeContext *s)
 
     /* unescape buffer of SOS, use special treatment for JPEG-LS */
     if (!s->ls) {
-        const uint8_t *src = buf_ptr;
-        const uint8_t *ptr = src;
-        uint8_t *dst = s->buffer;
-        PutByteContext pb;
-
-        bytestream2_init_writer(&pb, dst, buf_end - src);
-
-        while ((ptr = memchr(ptr, 0xff, buf_end - ptr))) {
-            ptr++;
-            if (ptr < buf_end) {
-                /* Copy verbatim data. */
-                ptrdiff_t length = (ptr - 1) - src;
-                if (length > 0)
-                    bytestream2_put_bufferu(&pb, src, length);
+        const uint8_t *ptr;
 
-                uint8_t x = *ptr++;
-                /* Discard multiple optional 0xFF fill bytes. */
-                while (x == 0xff && ptr < buf_end)
-                    x = *ptr++;
-
-                src = ptr;
-                if (x == 0) {
-                    /* Stuffed zero byte */
-                    bytestream2_put_byteu(&pb, 0xff);
-                } else if (x >= RST0 && x <= RST7) {
-                    /* Restart marker */
-                    goto found;
-                } else {
-                    /* Non-restart marker */
-                    ptr -= 2;
-                    goto found;
-                }
-            }
-        }
-        /* Copy remaining verbatim data. */
-        ptr = buf_end;
-        ptrdiff_t length = ptr - src;
-        if (length > 0)
-            bytestream2_put_bufferu(&pb, src, length);
-
-found:
         unescaped_buf_ptr  = s->buffer;
-        unescaped_buf_size = bytestream2_tell_p(&pb);
+        unescaped_buf_size = unescape_scan_data(s->buffer, buf_ptr, buf_end, &ptr);
         memset(s->buffer + unescaped_buf_size, 0,
                AV_INPUT_BUFFER_PADDING_SIZE);
 
@@ -2912,6 +3085,9 @@ av_cold int ff_mjpeg_decode_end(AVCodecContext *avctx)
     av_frame_free(&s->smv_frame);
 
     av_freep(&s->buffer);
+    av_freep(&s->rst_buffer);
+    av_freep(&s->rst_offsets);
+    av_freep(&s->rst_ret);
     av_freep(&s->stereo3d);
     av_freep(&s->ljpeg_buffer);
     s->ljpeg_buffer_size = 0;
@@ -2973,7 +3149,7 @@ const FFCodec ff_mjpeg_decoder = {
     .close          = ff_mjpeg_decode_end,
     FF_CODEC_DECODE_CB(ff_mjpeg_decode_frame),
     .flush          = decode_flush,
-    .p.capabilities = AV_CODEC_CAP_DR1,
+    .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_SLICE_THREADS,
     .p.max_lowres   = 3,
     .p.priv_class   = &mjpegdec_class,
     .p.profiles     = NULL_IF_CONFIG_SMALL(ff_mjpeg_profiles),
@@ -63,6 +63,14 @@ typedef struct MJpegDecodeContext {
     int buffer_size;
     uint8_t *buffer;
 
+    /* restart intervals of a scan, unescaped for slice threading */
+    uint8_t *rst_buffer;
+    unsigned int rst_buffer_size;
+    unsigned int *rst_offsets;      ///< start of each interval in rst_buffer
+    unsigned int rst_offsets_size;
+    int *rst_ret;
+    unsigned int rst_ret_size;
+
     uint16_t quant_matrixes[4][64];
     VLC vlcs[3][4];
     int qscale[4];      ///< quantizer scale calculated from quant_matrixes
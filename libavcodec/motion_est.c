@@ -82,12 +82,12 @@ static int minima_cmp(const void *a, const void *b){
 
 static inline void init_ref(MotionEstContext *c, uint8_t *const src[3],
                             uint8_t *const ref[3], uint8_t *const ref2[3],
-                            int x, int y, int ref_index)
+                            int x, int y, int ref_index, int chroma_y_shift)
 {
     const int offset[3]= {
           y*c->  stride + x,
-        ((y*c->uvstride + x)>>1),
-        ((y*c->uvstride + x)>>1),
+        (y >> chroma_y_shift) * c->uvstride + (x >> 1),
+        (y >> chroma_y_shift) * c->uvstride + (x >> 1),
     };
     int i;
     for(i=0; i<3; i++){
@@ -190,6 +190,9 @@ static av_always_inline int cmp_inline(MPVEncContext *const s, const int x, cons
     const int hy= suby + y*(1<<(1+qpel));
     const uint8_t * const * const ref = c->ref[ref_index];
     const uint8_t * const * const src = c->src[src_index];
+    /* 4:2:2 chroma has full vertical resolution and uses the luma vertical
+     * motion vector as is */
+    const int cy_shift = s->c.chroma_y_shift;
     int d;
     //FIXME check chroma 4mv, (no crashes ...)
     int uvdxy;              /* no, it might not be used uninitialized */
@@ -213,20 +216,20 @@ static av_always_inline int cmp_inline(MPVEncContext *const s, const int x, cons
         } else {
             c->hpel_put[size][dxy](c->temp, ref[0] + x + y * stride, stride, h);
             if (chroma)
-                uvdxy = dxy | (x & 1) | (2 * (y & 1));
+                uvdxy = dxy | (x & 1) | (2 * (y & cy_shift));
         }
         d = cmp_func(s, c->temp, src[0], stride, h);
     } else {
         d = cmp_func(s, src[0], ref[0] + x + y * stride, stride, h);
         if (chroma)
-            uvdxy = (x & 1) + 2 * (y & 1);
+            uvdxy = (x & 1) + 2 * (y & cy_shift);
     }
     if (chroma) {
         uint8_t *const uvtemp = c->temp + 16 * stride;
-        c->hpel_put[size + 1][uvdxy](uvtemp    , ref[1] + (x >> 1) + (y >> 1) * uvstride, uvstride, h >> 1);
-        c->hpel_put[size + 1][uvdxy](uvtemp + 8, ref[2] + (x >> 1) + (y >> 1) * uvstride, uvstride, h >> 1);
-        d += chroma_cmp_func(s, uvtemp    , src[1], uvstride, h >> 1);
-        d += chroma_cmp_func(s, uvtemp + 8, src[2], uvstride, h >> 1);
+        c->hpel_put[size + 1][uvdxy](uvtemp    , ref[1] + (x >> 1) + (y >> cy_shift) * uvstride, uvstride, h >> cy_shift);
+        c->hpel_put[size + 1][uvdxy](uvtemp + 8, ref[2] + (x >> 1) + (y >> cy_shift) * uvstride, uvstride, h >> cy_shift);
+        d += chroma_cmp_func(s, uvtemp    , src[1], uvstride, h >> cy_shift);
+        d += chroma_cmp_func(s, uvtemp + 8, src[2], uvstride, h >> cy_shift);
     }
     return d;
 }
@@ -897,7 +900,7 @@ void ff_estimate_p_frame_motion(MPVEncContext *const s,
     const int shift = 1 + s->c.quarter_sample;
     int mb_type=0;
 
-    init_ref(c, s->new_pic->data, s->c.last_pic.data, NULL, 16*mb_x, 16*mb_y, 0);
+    init_ref(c, s->new_pic->data, s->c.last_pic.data, NULL, 16*mb_x, 16*mb_y, 0, s->c.chroma_y_shift);
 
     av_assert0(s->c.quarter_sample == 0 || s->c.quarter_sample == 1);
     av_assert0(s->c.linesize == c->stride);
@@ -1068,7 +1071,7 @@ int ff_pre_estimate_p_frame_motion(MPVEncContext *const s,
     int P[10][2];
     const int shift = 1 + s->c.quarter_sample;
     const int xy    = mb_x + mb_y*s->c.mb_stride;
-    init_ref(c, s->new_pic->data, s->c.last_pic.data, NULL, 16*mb_x, 16*mb_y, 0);
+    init_ref(c, s->new_pic->data, s->c.last_pic.data, NULL, 16*mb_x, 16*mb_y, 0, s->c.chroma_y_shift);
 
     av_assert0(s->c.quarter_sample == 0 || s->c.quarter_sample == 1);
 
@@ -1492,7 +1495,7 @@ void ff_estimate_b_frame_motion(MPVEncContext *const s,
     int type=0;
     const int xy = mb_y*s->c.mb_stride + mb_x;
     init_ref(c, s->new_pic->data, s->c.last_pic.data,
-             s->c.next_pic.data, 16 * mb_x, 16 * mb_y, 2);
+             s->c.next_pic.data, 16 * mb_x, 16 * mb_y, 2, s->c.chroma_y_shift);
 
     get_limits(s, 16*mb_x, 16*mb_y, 1);
 
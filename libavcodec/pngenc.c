@@ -52,6 +52,18 @@ typedef struct APNGFctlChunk {
     uint8_t dispose_op, blend_op;
 } APNGFctlChunk;
 
+/* A horizontal stripe of the image, compressed as a separate piece of the
+ * deflate stream when slice threading is used. */
+typedef struct PNGEncStripe {
+    FFZStream zstream;
+    uint8_t *crow_base;
+    uint8_t *dict;
+    uint8_t *buf;
+    unsigned buf_size;
+    int len;
+    uLong adler;
+} PNGEncStripe;
+
 typedef struct PNGEncContext {
     AVClass *class;
     LLVidEncDSPContext llvidencdsp;
@@ -64,6 +76,12 @@ typedef struct PNGEncContext {
 
     FFZStream zstream;
     uint8_t buf[IOBUF_SIZE];
+    int compression_level;
+
+    PNGEncStripe *stripes;
+    int *stripe_ret;
+    int nb_stripes;
+    const AVFrame *stripe_frame;
     int dpi;                     ///< Physical pixel density, in dots per inch, if set
     int dpm;                     ///< Physical pixel density, in dots per meter, if set
 
@@ -302,6 +320,173 @@ static int png_write_row(AVCodecContext *avctx, const uint8_t *data, int size)
     return 0;
 }
 
+static int stripe_grow_buffer(PNGEncStripe *st, z_stream *zstream)
+{
+    size_t used = zstream->next_out - st->buf;
+    unsigned size;
+    uint8_t *buf;
+
+    if (st->buf_size > INT_MAX / 2)
+        return AVERROR(ENOMEM);
+    size = st->buf_size * 2;
+    buf  = av_realloc(st->buf, size);
+    if (!buf)
+        return AVERROR(ENOMEM);
+    st->buf            = buf;
+    st->buf_size       = size;
+    zstream->next_out  = buf + used;
+    zstream->avail_out = size - used;
+    return 0;
+}
+
+/**
+ * Filter and compress the rows of one stripe into a piece of raw deflate
+ * data. Every stripe but the first is primed with the filtered rows
+ * preceding it, and every stripe but the last ends with a sync flush, so
+ * that the pieces concatenate to a single valid stream.
+ */
+static int encode_stripe(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    PNGEncContext *s        = avctx->priv_data;
+    PNGEncStripe  *st       = &s->stripes[jobnr];
+    z_stream *const zstream = &st->zstream.zstream;
+    const AVFrame *const p  = s->stripe_frame;
+    const int row_size      = (p->width * s->bits_per_pixel + 7) >> 3;
+    const int bpp           = s->bits_per_pixel >> 3;
+    const int y_start       = p->height *  jobnr      / s->nb_stripes;
+    const int y_end         = p->height * (jobnr + 1) / s->nb_stripes;
+    const int flush         = jobnr == s->nb_stripes - 1 ? Z_FINISH : Z_SYNC_FLUSH;
+    uint8_t *crow_buf       = st->crow_base + 15;
+    const uint8_t *top      = NULL;
+    unsigned size;
+    int ret;
+
+    st->len = 0;
+    deflateReset(zstream);
+    st->adler = adler32(0, NULL, 0);
+
+    if (y_start) {
+        int dict_rows = FFMIN(y_start, (32768 + row_size) / (row_size + 1));
+        uint8_t *dict = st->dict;
+
+        for (int y = y_start - dict_rows; y < y_start; y++) {
+            const uint8_t *ptr = p->data[0] + y * p->linesize[0];
+            const uint8_t *crow;
+
+            top  = y ? ptr - p->linesize[0] : NULL;
+            crow = png_choose_filter(s, crow_buf, ptr, top, row_size, bpp);
+            memcpy(dict, crow, row_size + 1);
+            dict += row_size + 1;
+        }
+        if (deflateSetDictionary(zstream, st->dict, dict - st->dict) != Z_OK)
+            return AVERROR_EXTERNAL;
+        top = p->data[0] + (y_start - 1) * p->linesize[0];
+    }
+
+    size = deflateBound(zstream, (y_end - y_start) * (row_size + 1)) + 64;
+    av_fast_malloc(&st->buf, &st->buf_size, size);
+    if (!st->buf)
+        return AVERROR(ENOMEM);
+    zstream->next_out  = st->buf;
+    zstream->avail_out = st->buf_size;
+
+    for (int y = y_start; y < y_end; y++) {
+        const uint8_t *ptr = p->data[0] + y * p->linesize[0];
+        uint8_t *crow = png_choose_filter(s, crow_buf, ptr, top, row_size, bpp);
+
+        st->adler = adler32(st->adler, crow, row_size + 1);
+        zstream->next_in  = crow;
+        zstream->avail_in = row_size + 1;
+        while (zstream->avail_in > 0) {
+            if (deflate(zstream, Z_NO_FLUSH) != Z_OK)
+                return AVERROR_EXTERNAL;
+            if (!zstream->avail_out && (ret = stripe_grow_buffer(st, zstream)) < 0)
+                return ret;
+        }
+        top = ptr;
+    }
+    for (;;) {
+        ret = deflate(zstream, flush);
+        if (ret != Z_OK && ret != Z_STREAM_END)
+            return AVERROR_EXTERNAL;
+        if (ret == Z_STREAM_END || (flush == Z_SYNC_FLUSH && zstream->avail_out))
+            break;
+        if ((ret = stripe_grow_buffer(st, zstream)) < 0)
+            return ret;
+    }
+    st->len = zstream->next_out - st->buf;
+
+    return 0;
+}
+
+static void png_write_stream_data(AVCodecContext *avctx, int *buf_len,
+                                  const uint8_t *data, int size)
+{
+    PNGEncContext *s = avctx->priv_data;
+
+    while (size > 0) {
+        int len = FFMIN(size, IOBUF_SIZE - *buf_len);
+
+        memcpy(s->buf + *buf_len, data, len);
+        *buf_len += len;
+        data     += len;
+        size     -= len;
+        if (*buf_len == IOBUF_SIZE) {
+            png_write_image_data(avctx, s->buf, IOBUF_SIZE);
+            *buf_len = 0;
+        }
+    }
+}
+
+static int encode_frame_stripes(AVCodecContext *avctx, const AVFrame *pict)
+{
+    PNGEncContext *s = avctx->priv_data;
+    int64_t total = 6;
+    uLong adler;
+    uint8_t header[4];
+    int level_flags, buf_len = 0;
+
+    s->stripe_frame = pict;
+    avctx->execute2(avctx, encode_stripe, NULL, s->stripe_ret, s->nb_stripes);
+    s->stripe_frame = NULL;
+
+    for (int i = 0; i < s->nb_stripes; i++) {
+        if (s->stripe_ret[i] < 0)
+            return s->stripe_ret[i];
+        total += s->stripes[i].len;
+    }
+    if (total + 12 * ((total + IOBUF_SIZE - 1) / IOBUF_SIZE) >
+        s->bytestream_end - s->bytestream - 100)
+        return AVERROR(ENOMEM);
+
+    /* zlib header as deflate would write it for the compression level */
+    level_flags = s->compression_level == Z_DEFAULT_COMPRESSION ? 2 :
+                  s->compression_level < 2 ? 0 :
+                  s->compression_level < 6 ? 1 :
+                  s->compression_level == 6 ? 2 : 3;
+    AV_WB16(header, (Z_DEFLATED + ((MAX_WBITS - 8) << 4)) << 8 | level_flags << 6);
+    AV_WB16(header, AV_RB16(header) + 31 - AV_RB16(header) % 31);
+    png_write_stream_data(avctx, &buf_len, header, 2);
+
+    adler = adler32(0, NULL, 0);
+    for (int i = 0; i < s->nb_stripes; i++) {
+        const PNGEncStripe *st = &s->stripes[i];
+        const int y_start = pict->height *  i      / s->nb_stripes;
+        const int y_end   = pict->height * (i + 1) / s->nb_stripes;
+        const int row_size = (pict->width * s->bits_per_pixel + 7) >> 3;
+
+        adler = adler32_combine(adler, st->adler,
+                                (z_off_t)(y_end - y_start) * (row_size + 1));
+        png_write_stream_data(avctx, &buf_len, st->buf, st->len);
+    }
+    AV_WB32(header, adler);
+    png_write_stream_data(avctx, &buf_len, header, 4);
+    if (buf_len)
+        png_write_image_data(avctx, s->buf, buf_len);
+
+    return 0;
+}
+
 #define PNG_LRINT(d, divisor) lrint((d) * (divisor))
 #define PNG_Q2D(q, divisor) PNG_LRINT(av_q2d(q), (divisor))
 #define AV_WB32_PNG_D(buf, q) AV_WB32(buf, PNG_Q2D(q, 100000))
@@ -530,6 +715,9 @@ static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
     uint8_t *progressive_buf = NULL;
     uint8_t *top_buf         = NULL;
 
+    if (s->nb_stripes > 1)
+        return encode_frame_stripes(avctx, pict);
+
     row_size = (pict->width * s->bits_per_pixel + 7) >> 3;
 
     crow_base = av_malloc((row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
@@ -1247,6 +1435,30 @@ static av_cold int png_enc_init(AVCodecContext *avctx)
     compression_level = avctx->compression_level == FF_COMPRESSION_DEFAULT
                       ? Z_DEFAULT_COMPRESSION
                       : av_clip(avctx->compression_level, 0, 9);
+    s->compression_level = compression_level;
+
+    if (avctx->active_thread_type & FF_THREAD_SLICE && !s->is_progressive) {
+        const int row_size = (avctx->width * s->bits_per_pixel + 7) >> 3;
+
+        s->nb_stripes = FFMIN(avctx->thread_count, avctx->height);
+        s->stripes    = av_calloc(s->nb_stripes, sizeof(*s->stripes));
+        s->stripe_ret = av_calloc(s->nb_stripes, sizeof(*s->stripe_ret));
+        if (!s->stripes || !s->stripe_ret)
+            return AVERROR(ENOMEM);
+        for (int i = 0; i < s->nb_stripes; i++) {
+            PNGEncStripe *st = &s->stripes[i];
+            int ret;
+
+            st->crow_base = av_malloc((row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
+            st->dict      = av_malloc(32768 + row_size + 1);
+            if (!st->crow_base || !st->dict)
+                return AVERROR(ENOMEM);
+            ret = ff_deflate_init2(&st->zstream, compression_level, -MAX_WBITS, avctx);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
     return ff_deflate_init(&s->zstream, compression_level, avctx);
 }
 
@@ -1255,6 +1467,14 @@ static av_cold int png_enc_close(AVCodecContext *avctx)
     PNGEncContext *s = avctx->priv_data;
 
     ff_deflate_end(&s->zstream);
+    for (int i = 0; i < s->nb_stripes; i++) {
+        ff_deflate_end(&s->stripes[i].zstream);
+        av_freep(&s->stripes[i].crow_base);
+        av_freep(&s->stripes[i].dict);
+        av_freep(&s->stripes[i].buf);
+    }
+    av_freep(&s->stripes);
+    av_freep(&s->stripe_ret);
     av_frame_free(&s->last_frame);
     av_frame_free(&s->prev_frame);
     av_buffer_unref(&s->exif_data);
@@ -1292,6 +1512,7 @@ const FFCodec ff_png_encoder = {
     .p.type         = AVMEDIA_TYPE_VIDEO,
     .p.id           = AV_CODEC_ID_PNG,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS |
+                      AV_CODEC_CAP_SLICE_THREADS |
                       AV_CODEC_CAP_ENCODER_REORDERED_OPAQUE,
     .priv_data_size = sizeof(PNGEncContext),
     .init           = png_enc_init,
@@ -1305,7 +1526,7 @@ const FFCodec ff_png_encoder = {
                   AV_PIX_FMT_MONOBLACK),
     .alpha_modes    = AVALPHA_MODE_STRAIGHT,
     .p.priv_class   = &pngenc_class,
-    .caps_internal  = FF_CODEC_CAP_ICC_PROFILES,
+    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP | FF_CODEC_CAP_ICC_PROFILES,
 };
 
 const FFCodec ff_apng_encoder = {
@@ -1326,5 +1547,5 @@ const FFCodec ff_apng_encoder = {
                   AV_PIX_FMT_GRAY16BE, AV_PIX_FMT_YA16BE),
     .alpha_modes    = AVALPHA_MODE_STRAIGHT,
     .p.priv_class   = &pngenc_class,
-    .caps_internal  = FF_CODEC_CAP_ICC_PROFILES,
+    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP | FF_CODEC_CAP_ICC_PROFILES,
 };
@@ -28,9 +28,11 @@
 
 #include "config_components.h"
 
+#include "libavutil/avassert.h"
 #include "libavutil/internal.h"
 #include "libavutil/mem.h"
 #include "libavutil/mem_internal.h"
+#include "libavutil/thread.h"
 
 #include "avcodec.h"
 #include "codec_internal.h"
@@ -130,8 +132,107 @@ static void unpack_alpha_12(GetBitContext *gb, uint16_t *dst, int num_coeffs,
     }
 }
 
+// adaptive codebook switching lut according to previous run/level values
+static const uint8_t run_to_cb[16] = { 0x06, 0x06, 0x05, 0x05, 0x04, 0x29, 0x29, 0x29, 0x29, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x4C };
+static const uint8_t lev_to_cb[10] = { 0x04, 0x0A, 0x05, 0x06, 0x04, 0x28, 0x28, 0x28, 0x28, 0x4C };
+
+/* Number of distinct codebooks in run_to_cb and lev_to_cb */
+#define NB_RUN_CB 6
+#define NB_LEV_CB 6
+
+#define AC_LUT_BITS 8
+
+/* A run, level and sign triplet whose codes fit into AC_LUT_BITS bits */
+typedef struct ACLUTEntry {
+    uint8_t len;    ///< total code length, 0 if the codes are longer
+    uint8_t run;
+    uint8_t level;  ///< absolute level
+    int8_t  sign;   ///< 0 or -1
+} ACLUTEntry;
+
+static uint8_t run_cb_idx[16];
+static uint8_t lev_cb_idx[10];
+/* one table per run and level codebook combination */
+static ACLUTEntry ac_lut[NB_RUN_CB * NB_LEV_CB][1 << AC_LUT_BITS];
+
+/* DECODE_CODEWORD() on the 32 bits in buf, returns -1 for invalid codes */
+static av_cold int lut_decode_codeword(uint32_t buf, unsigned codebook, int *len)
+{
+    unsigned switch_bits =  codebook & 3;
+    unsigned rice_order  =  codebook >> 5;
+    unsigned exp_order   = (codebook >> 2) & 7;
+    unsigned q = 31 - av_log2(buf);
+
+    if (q > switch_bits) {
+        unsigned bits = exp_order - switch_bits + (q << 1);
+        if (bits > 31)
+            return -1;
+        *len = bits;
+        return (buf >> (32 - bits)) - (1 << exp_order) +
+               ((switch_bits + 1) << rice_order);
+    } else if (rice_order) {
+        *len = q + 1 + rice_order;
+        return (q << rice_order) + ((buf << (q + 1)) >> (32 - rice_order));
+    } else {
+        *len = q + 1;
+        return q;
+    }
+}
+
+static av_cold int codebook_index(uint8_t *cb_idx, const uint8_t *to_cb, int nb)
+{
+    int nb_cb = 0;
+
+    for (int i = 0; i < nb; i++) {
+        int j;
+        for (j = 0; j < i && to_cb[j] != to_cb[i]; j++)
+            ;
+        cb_idx[i] = j < i ? cb_idx[j] : nb_cb++;
+    }
+    return nb_cb;
+}
+
+static av_cold void init_ac_lut(void)
+{
+    uint8_t run_cb[NB_RUN_CB], lev_cb[NB_LEV_CB];
+    int nb_run_cb = codebook_index(run_cb_idx, run_to_cb, 16);
+    int nb_lev_cb = codebook_index(lev_cb_idx, lev_to_cb, 10);
+
+    av_assert0(nb_run_cb == NB_RUN_CB && nb_lev_cb == NB_LEV_CB);
+    for (int i = 0; i < 16; i++)
+        run_cb[run_cb_idx[i]] = run_to_cb[i];
+    for (int i = 0; i < 10; i++)
+        lev_cb[lev_cb_idx[i]] = lev_to_cb[i];
+
+    for (int r = 0; r < NB_RUN_CB; r++) {
+        for (int l = 0; l < NB_LEV_CB; l++) {
+            ACLUTEntry *lut = ac_lut[r * NB_LEV_CB + l];
+
+            for (unsigned i = 0; i < 1 << AC_LUT_BITS; i++) {
+                uint32_t buf = i << (32 - AC_LUT_BITS);
+                int run, level, run_len, level_len;
+
+                run = lut_decode_codeword(buf, run_cb[r], &run_len);
+                if (run < 0 || run > UINT8_MAX || run_len >= AC_LUT_BITS)
+                    continue;
+                buf <<= run_len;
+                level = lut_decode_codeword(buf, lev_cb[l], &level_len) + 1;
+                if (level <= 0 || level > UINT8_MAX ||
+                    run_len + level_len + 1 > AC_LUT_BITS)
+                    continue;
+
+                lut[i].len   = run_len + level_len + 1;
+                lut[i].run   = run;
+                lut[i].level = level;
+                lut[i].sign  = -(int)(buf << level_len >> 31);
+            }
+        }
+    }
+}
+
 static av_cold int decode_init(AVCodecContext *avctx)
 {
+    static AVOnce init_static_once = AV_ONCE_INIT;
     ProresContext *ctx = avctx->priv_data;
 
     avctx->bits_per_raw_sample = 10;
@@ -179,6 +280,8 @@ static av_cold int decode_init(AVCodecContext *avctx)
 
     ctx->pix_fmt = AV_PIX_FMT_NONE;
 
+    ff_thread_once(&init_static_once, init_ac_lut);
+
     return 0;
 }
 
@@ -485,10 +588,6 @@ static av_always_inline int decode_dc_coeffs(GetBitContext *gb, int16_t *out,
     return 0;
 }
 
-// adaptive codebook switching lut according to previous run/level values
-static const uint8_t run_to_cb[16] = { 0x06, 0x06, 0x05, 0x05, 0x04, 0x29, 0x29, 0x29, 0x29, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x4C };
-static const uint8_t lev_to_cb[10] = { 0x04, 0x0A, 0x05, 0x06, 0x04, 0x28, 0x28, 0x28, 0x28, 0x4C };
-
 static av_always_inline int decode_ac_coeffs(AVCodecContext *avctx, GetBitContext *gb,
                                              int16_t *out, int blocks_per_slice)
 {
@@ -507,29 +606,46 @@ static av_always_inline int decode_ac_coeffs(AVCodecContext *avctx, GetBitContex
     block_mask = blocks_per_slice - 1;
 
     for (pos = block_mask;;) {
+        const ACLUTEntry *e;
+
         bits_left = gb->size_in_bits - re_index;
         if (bits_left <= 0 || (bits_left < 32 && !SHOW_UBITS(re, gb, bits_left)))
             break;
 
-        DECODE_CODEWORD(run, run_to_cb[FFMIN(run,  15)], LAST_SKIP_BITS);
-        pos += run + 1;
-        if (pos >= max_coeffs) {
-            av_log(avctx, AV_LOG_ERROR, "ac tex damaged %d, %d\n", pos, max_coeffs);
-            return AVERROR_INVALIDDATA;
-        }
+        UPDATE_CACHE_32(re, gb);
+        e = &ac_lut[run_cb_idx[FFMIN(run, 15)] * NB_LEV_CB +
+                    lev_cb_idx[FFMIN(level, 9)]][SHOW_UBITS(re, gb, AC_LUT_BITS)];
+        if (e->len) {
+            run   = e->run;
+            level = e->level;
+            sign  = e->sign;
+            SKIP_BITS(re, gb, e->len);
+            pos += run + 1;
+            if (pos >= max_coeffs)
+                goto damaged;
+        } else {
+            DECODE_CODEWORD(run, run_to_cb[FFMIN(run,  15)], LAST_SKIP_BITS);
+            pos += run + 1;
+            if (pos >= max_coeffs)
+                goto damaged;
 
-        DECODE_CODEWORD(level, lev_to_cb[FFMIN(level, 9)], SKIP_BITS);
-        level += 1;
+            DECODE_CODEWORD(level, lev_to_cb[FFMIN(level, 9)], SKIP_BITS);
+            level += 1;
 
-        i = pos >> log2_block_count;
+            sign = SHOW_SBITS(re, gb, 1);
+            SKIP_BITS(re, gb, 1);
+        }
 
-        sign = SHOW_SBITS(re, gb, 1);
-        SKIP_BITS(re, gb, 1);
+        i = pos >> log2_block_count;
         out[((pos & block_mask) << 6) + ctx->scan[i]] = ((level ^ sign) - sign);
     }
 
     CLOSE_READER(re, gb);
     return 0;
+
+damaged:
+    av_log(avctx, AV_LOG_ERROR, "ac tex damaged %d, %d\n", pos, max_coeffs);
+    return AVERROR_INVALIDDATA;
 }
 
 static int decode_slice_luma(AVCodecContext *avctx, SliceContext *slice,
@@ -446,12 +446,13 @@ static int estimate_dcs(int *error, int16_t *blocks, int blocks_per_slice,
 }
 
 static int estimate_acs(int *error, int16_t *blocks, int blocks_per_slice,
-                        const uint8_t *scan, const int16_t *qmat)
+                        const uint8_t *scan, const int16_t *qmat,
+                        int bits_limit)
 {
     int idx, i;
     int prev_run = 4;
     int prev_level = 2;
-    int run, level;
+    int run;
     int max_coeffs, abs_level;
     int bits = 0;
 
@@ -459,14 +460,23 @@ static int estimate_acs(int *error, int16_t *blocks, int blocks_per_slice,
     run        = 0;
 
     for (i = 1; i < 64; i++) {
+        const unsigned quant = qmat[scan[i]];
+        /* abs * recip >> 32 == abs / quant as long as abs * quant < 2^32,
+         * which holds for 16-bit coefficients and quantisers */
+        const uint64_t recip = (UINT64_C(1) << 32) / quant + 1;
+
         for (idx = scan[i]; idx < max_coeffs; idx += 64) {
-            level   = blocks[idx] / qmat[scan[i]];
-            *error += FFABS(blocks[idx]) % qmat[scan[i]];
-            if (level) {
-                abs_level = FFABS(level);
+            unsigned abs_coeff = FFABS(blocks[idx]);
+
+            abs_level = abs_coeff * recip >> 32;
+            *error   += abs_coeff - abs_level * quant;
+            if (abs_level) {
                 bits += estimate_vlc(ff_prores_run_to_cb[prev_run], run);
                 bits += estimate_vlc(ff_prores_level_to_cb[prev_level],
                                      abs_level - 1) + 1;
+                /* the caller only needs to know the slice does not fit */
+                if (bits > bits_limit)
+                    return bits;
                 prev_run   = FFMIN(run, 15);
                 prev_level = FFMIN(abs_level, 9);
                 run    = 0;
@@ -480,10 +490,10 @@ static int estimate_acs(int *error, int16_t *blocks, int blocks_per_slice,
 }
 
 static int estimate_slice_plane(ProresContext *ctx, int *error, int plane,
-                                const uint16_t *src, ptrdiff_t linesize,
                                 int mbs_per_slice,
                                 int blocks_per_mb,
-                                const int16_t *qmat, ProresThreadData *td)
+                                const int16_t *qmat, int bits_limit,
+                                ProresThreadData *td)
 {
     int blocks_per_slice;
     int bits;
@@ -491,11 +501,47 @@ static int estimate_slice_plane(ProresContext *ctx, int *error, int plane,
     blocks_per_slice = mbs_per_slice * blocks_per_mb;
 
     bits  = estimate_dcs(error, td->blocks[plane], blocks_per_slice, qmat[0]);
-    bits += estimate_acs(error, td->blocks[plane], blocks_per_slice, ctx->scantable, qmat);
+    bits += estimate_acs(error, td->blocks[plane], blocks_per_slice, ctx->scantable, qmat,
+                         bits_limit - bits);
 
     return FFALIGN(bits, 8);
 }
 
+/**
+ * Estimate the size of a slice coded with quantiser q.
+ *
+ * @param bits       size of the alpha plane
+ * @param bits_limit the estimation stops as soon as the slice is known to be
+ *                   larger than this, the returned size and error are
+ *                   incomplete then
+ */
+static int estimate_slice_quant(ProresContext *ctx, ProresThreadData *td,
+                                int q, int mbs_per_slice, const int *num_cblocks,
+                                int bits, int bits_limit, int *error)
+{
+    const int16_t *qmat, *qmat_chroma;
+    int i;
+
+    if (q < MAX_STORED_Q) {
+        qmat        = ctx->quants[q];
+        qmat_chroma = ctx->quants_chroma[q];
+    } else {
+        for (i = 0; i < 64; i++) {
+            td->custom_q[i]        = ctx->quant_mat[i] * q;
+            td->custom_chroma_q[i] = ctx->quant_chroma_mat[i] * q;
+        }
+        qmat        = td->custom_q;
+        qmat_chroma = td->custom_chroma_q;
+    }
+
+    *error = 0;
+    for (i = 0; i < ctx->num_planes - !!ctx->alpha_bits && bits <= bits_limit; i++)
+        bits += estimate_slice_plane(ctx, error, i, mbs_per_slice, num_cblocks[i],
+                                     i ? qmat_chroma : qmat, bits_limit - bits, td);
+
+    return bits;
+}
+
 static int est_alpha_diff(int cur, int prev, int abits)
 {
     const int dbits = (abits == 8) ? 4 : 7;
@@ -568,8 +614,6 @@ static int find_slice_quant(AVCodecContext *avctx,
     int mbs, prev, cur, new_score;
     int slice_bits[TRELLIS_WIDTH], slice_score[TRELLIS_WIDTH];
     int overquant;
-    uint16_t *qmat;
-    uint16_t *qmat_chroma;
     int linesize[4], line_add;
     int alpha_bits = 0;
 
@@ -619,20 +663,8 @@ static int find_slice_quant(AVCodecContext *avctx,
                                           mbs_per_slice, td->blocks[3]);
     // todo: maybe perform coarser quantising to fit into frame size when needed
     for (q = min_quant; q <= max_quant; q++) {
-        bits  = alpha_bits;
-        error = 0;
-        bits += estimate_slice_plane(ctx, &error, 0,
-                                     src, linesize[0],
-                                     mbs_per_slice,
-                                     num_cblocks[0],
-                                     ctx->quants[q], td); /* estimate luma plane */
-        for (i = 1; i < ctx->num_planes - !!ctx->alpha_bits; i++) { /* estimate chroma plane */
-            bits += estimate_slice_plane(ctx, &error, i,
-                                         src, linesize[i],
-                                         mbs_per_slice,
-                                         num_cblocks[i],
-                                         ctx->quants_chroma[q], td);
-        }
+        bits = estimate_slice_quant(ctx, td, q, mbs_per_slice, num_cblocks,
+                                    alpha_bits, INT_MAX, &error);
         if (bits > 65000 * 8)
             error = SCORE_LIMIT;
 
@@ -644,34 +676,47 @@ static int find_slice_quant(AVCodecContext *avctx,
         slice_score[max_quant + 1] = slice_score[max_quant] + 1;
         overquant = max_quant;
     } else {
-        for (q = max_quant + 1; q < 128; q++) {
-            bits  = alpha_bits;
-            error = 0;
-            if (q < MAX_STORED_Q) {
-                qmat = ctx->quants[q];
-                qmat_chroma = ctx->quants_chroma[q];
-            } else {
-                qmat = td->custom_q;
-                qmat_chroma = td->custom_chroma_q;
-                for (i = 0; i < 64; i++) {
-                    qmat[i] = ctx->quant_mat[i] * q;
-                    qmat_chroma[i] = ctx->quant_chroma_mat[i] * q;
+        const int slice_limit = ctx->bits_per_mb * mbs_per_slice;
+
+        if (ctx->quant_search == QUANT_SEARCH_BISECT) {
+            /* smallest quantiser known to fit, 128 if none does */
+            int fit_bits = 0, fit_error = 0;
+            int lo = max_quant + 1;
+
+            q = 128;
+            while (lo < q) {
+                int mid = (lo + q) >> 1;
+                bits = estimate_slice_quant(ctx, td, mid, mbs_per_slice,
+                                            num_cblocks, alpha_bits,
+                                            slice_limit, &error);
+                if (bits <= slice_limit) {
+                    q         = mid;
+                    fit_bits  = bits;
+                    fit_error = error;
+                } else {
+                    lo = mid + 1;
                 }
             }
-            bits += estimate_slice_plane(ctx, &error, 0,
-                                         src, linesize[0],
-                                         mbs_per_slice,
-                                         num_cblocks[0],
-                                         qmat, td);/* estimate luma plane */
-            for (i = 1; i < ctx->num_planes - !!ctx->alpha_bits; i++) { /* estimate chroma plane */
-                bits += estimate_slice_plane(ctx, &error, i,
-                                             src, linesize[i],
-                                             mbs_per_slice,
-                                             num_cblocks[i],
-                                             qmat_chroma, td);
+            if (q < 128) {
+                bits  = fit_bits;
+                error = fit_error;
+            } else {
+                bits = estimate_slice_quant(ctx, td, 127, mbs_per_slice,
+                                            num_cblocks, alpha_bits,
+                                            INT_MAX, &error);
+            }
+        } else {
+            for (q = max_quant + 1; q < 128; q++) {
+                /* only the last quantiser is needed in full if it does
+                 * not fit, the others can be dropped as soon as they
+                 * exceed the limit */
+                bits = estimate_slice_quant(ctx, td, q, mbs_per_slice,
+                                            num_cblocks, alpha_bits,
+                                            q < 127 ? slice_limit : INT_MAX,
+                                            &error);
+                if (bits <= slice_limit)
+                    break;
             }
-            if (bits <= ctx->bits_per_mb * mbs_per_slice)
-                break;
         }
 
         slice_bits[max_quant + 1]  = bits;
@@ -1009,6 +1054,13 @@ static const AVOption options[] = {
         0, 0, VE, .unit = "quant_mat" },
     { "alpha_bits", "bits for alpha plane", OFFSET(alpha_bits), AV_OPT_TYPE_INT,
         { .i64 = 16 }, 0, 16, VE },
+    { "quant_search", "search for quantisers above the profile range", OFFSET(quant_search),
+        AV_OPT_TYPE_INT, { .i64 = QUANT_SEARCH_EXHAUSTIVE },
+        QUANT_SEARCH_EXHAUSTIVE, QUANT_SEARCH_BISECT, VE, .unit = "quant_search" },
+    { "exhaustive",    NULL, 0, AV_OPT_TYPE_CONST, { .i64 = QUANT_SEARCH_EXHAUSTIVE },
+        0, 0, VE, .unit = "quant_search" },
+    { "bisect",        NULL, 0, AV_OPT_TYPE_CONST, { .i64 = QUANT_SEARCH_BISECT },
+        0, 0, VE, .unit = "quant_search" },
     { NULL }
 };
 
@@ -65,6 +65,11 @@ enum {
     QUANT_MAT_DEFAULT,
 };
 
+enum {
+    QUANT_SEARCH_EXHAUSTIVE = 0,
+    QUANT_SEARCH_BISECT,
+};
+
 struct AVCodecContext;
 struct AVFrame;
 
@@ -110,6 +115,7 @@ typedef struct ProresContext {
 
     char *vendor;
     int quant_sel;
+    int quant_search;
 
     int frame_size_upper_bound;
 
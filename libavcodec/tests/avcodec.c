@@ -200,7 +200,8 @@ int main(void){
                 codec->capabilities & AV_CODEC_CAP_ENCODER_FLUSH)
                 ERR("Frame-threaded encoder %s claims to support flushing\n");
             if (codec->capabilities & AV_CODEC_CAP_FRAME_THREADS &&
-                codec->capabilities & AV_CODEC_CAP_DELAY)
+                codec->capabilities & AV_CODEC_CAP_DELAY &&
+                !(codec2->caps_internal & FF_CODEC_CAP_EOF_FLUSH))
                 ERR("Frame-threaded encoder %s claims to have delay\n");
 
             if (codec2->caps_internal & FF_CODEC_CAP_EOF_FLUSH &&
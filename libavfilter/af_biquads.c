@@ -121,6 +121,7 @@ typedef struct BiquadsContext {
     int transform_type;
     int precision;
     int block_samples;
+    int cascade;
 
     int bypass;
 
@@ -1023,7 +1024,7 @@ static int config_filter(AVFilterLink *outlink, int reset)
     }
 
     if (!s->cache[0])
-        s->cache[0] = ff_get_audio_buffer(outlink, 4 * sizeof(double));
+        s->cache[0] = ff_get_audio_buffer(outlink, 4 * sizeof(double) * s->cascade);
     if (!s->clip)
         s->clip = av_calloc(outlink->ch_layout.nb_channels, sizeof(*s->clip));
     if (!s->cache[0] || !s->clip)
@@ -1035,7 +1036,7 @@ static int config_filter(AVFilterLink *outlink, int reset)
 
     if (reset && s->block_samples > 0) {
         if (!s->cache[1])
-            s->cache[1] = ff_get_audio_buffer(outlink, 4 * sizeof(double));
+            s->cache[1] = ff_get_audio_buffer(outlink, 4 * sizeof(double) * s->cascade);
         if (!s->cache[1])
             return AVERROR(ENOMEM);
         av_samples_set_silence(s->cache[1]->extended_data, 0, s->cache[1]->nb_samples,
@@ -1238,6 +1239,35 @@ static void reverse_samples(AVFrame *out, AVFrame *in, int p,
     }
 }
 
+#define CASCADE_CHUNK 256
+
+/* Run all cascaded sections over a short chunk before moving on, so the
+ * data is only streamed through memory once. */
+static void filter_cascade(BiquadsContext *s, const void *input, void *output, int len,
+                           void *cache, int *clip, int disabled)
+{
+    const uint8_t *src = input;
+    uint8_t *dst = output;
+
+    if (s->cascade == 1) {
+        s->filter(s, input, output, len, cache, clip, disabled);
+        return;
+    }
+
+    for (int i = 0; i < len; i += CASCADE_CHUNK) {
+        const int nb_samples = FFMIN(CASCADE_CHUNK, len - i);
+        uint8_t *fcache = cache;
+
+        s->filter(s, src, dst, nb_samples, fcache, clip, disabled);
+        for (int n = 1; n < s->cascade; n++) {
+            fcache += 4 * sizeof(double);
+            s->filter(s, dst, dst, nb_samples, fcache, clip, disabled);
+        }
+        src += nb_samples * s->block_align;
+        dst += nb_samples * s->block_align;
+    }
+}
+
 static int filter_channel(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     AVFilterLink *inlink = ctx->inputs[0];
@@ -1260,8 +1290,8 @@ static int filter_channel(AVFilterContext *ctx, void *arg, int jobnr, int nb_job
         }
 
         if (!s->block_samples) {
-            s->filter(s, buf->extended_data[ch], out_buf->extended_data[ch], buf->nb_samples,
-                      s->cache[0]->extended_data[ch], s->clip+ch, ctx->is_disabled);
+            filter_cascade(s, buf->extended_data[ch], out_buf->extended_data[ch], buf->nb_samples,
+                           s->cache[0]->extended_data[ch], s->clip+ch, ctx->is_disabled);
         } else if (td->eof) {
             memcpy(out_buf->extended_data[ch], s->block[1]->extended_data[ch] + s->block_align * s->block_samples,
                    s->nb_samples * s->block_align);
@@ -1270,20 +1300,20 @@ static int filter_channel(AVFilterContext *ctx, void *arg, int jobnr, int nb_job
                    buf->nb_samples * s->block_align);
             memset(s->block[0]->extended_data[ch] + s->block_align * (s->block_samples + buf->nb_samples),
                    0, (s->block_samples - buf->nb_samples) * s->block_align);
-            s->filter(s, s->block[0]->extended_data[ch], s->block[1]->extended_data[ch], s->block_samples,
-                      s->cache[0]->extended_data[ch], s->clip+ch, ctx->is_disabled);
+            filter_cascade(s, s->block[0]->extended_data[ch], s->block[1]->extended_data[ch], s->block_samples,
+                           s->cache[0]->extended_data[ch], s->clip+ch, ctx->is_disabled);
             av_samples_copy(s->cache[1]->extended_data, s->cache[0]->extended_data, 0, 0,
                             s->cache[0]->nb_samples, s->cache[0]->ch_layout.nb_channels,
                             s->cache[0]->format);
-            s->filter(s, s->block[0]->extended_data[ch] + s->block_samples * s->block_align,
-                      s->block[1]->extended_data[ch] + s->block_samples * s->block_align,
-                      s->block_samples, s->cache[1]->extended_data[ch], s->clip+ch,
-                      ctx->is_disabled);
+            filter_cascade(s, s->block[0]->extended_data[ch] + s->block_samples * s->block_align,
+                           s->block[1]->extended_data[ch] + s->block_samples * s->block_align,
+                           s->block_samples, s->cache[1]->extended_data[ch], s->clip+ch,
+                           ctx->is_disabled);
             reverse_samples(s->block[2], s->block[1], ch, 0, 0, 2 * s->block_samples);
             av_samples_set_silence(s->cache[1]->extended_data, 0, s->cache[1]->nb_samples,
                                    s->cache[1]->ch_layout.nb_channels, s->cache[1]->format);
-            s->filter(s, s->block[2]->extended_data[ch], s->block[2]->extended_data[ch], 2 * s->block_samples,
-                      s->cache[1]->extended_data[ch], s->clip+ch, ctx->is_disabled);
+            filter_cascade(s, s->block[2]->extended_data[ch], s->block[2]->extended_data[ch], 2 * s->block_samples,
+                           s->cache[1]->extended_data[ch], s->clip+ch, ctx->is_disabled);
             reverse_samples(s->block[1], s->block[2], ch, 0, 0, 2 * s->block_samples);
             memcpy(out_buf->extended_data[ch], s->block[1]->extended_data[ch],
                    s->block_samples * s->block_align);
@@ -1521,6 +1551,9 @@ const FFFilter ff_af_##name_ = {                         \
     {"blocksize", "set the block size", OFFSET(block_samples), AV_OPT_TYPE_INT, {.i64=x}, 0, 32768, AF}, \
     {"b",         "set the block size", OFFSET(block_samples), AV_OPT_TYPE_INT, {.i64=x}, 0, 32768, AF}
 
+#define CASCADE_OPTION(x)                                                                                     \
+    {"cascade", "set the number of cascaded sections", OFFSET(cascade), AV_OPT_TYPE_INT, {.i64=x}, 1, 16, AF}
+
 #if CONFIG_EQUALIZER_FILTER
 static const AVOption equalizer_options[] = {
     {"frequency", "set central frequency", OFFSET(frequency), AV_OPT_TYPE_DOUBLE, {.dbl=0}, 0, 999999, FLAGS},
@@ -1533,6 +1566,7 @@ static const AVOption equalizer_options[] = {
     TRANSFORM_OPTION(DI),
     PRECISION_OPTION(-1),
     BLOCKSIZE_OPTION(0),
+    CASCADE_OPTION(1),
     {NULL}
 };
 
@@ -1552,6 +1586,7 @@ static const AVOption bass_lowshelf_options[] = {
     TRANSFORM_OPTION(DI),
     PRECISION_OPTION(-1),
     BLOCKSIZE_OPTION(0),
+    CASCADE_OPTION(1),
     {NULL}
 };
 
@@ -1578,6 +1613,7 @@ static const AVOption treble_highshelf_options[] = {
     TRANSFORM_OPTION(DI),
     PRECISION_OPTION(-1),
     BLOCKSIZE_OPTION(0),
+    CASCADE_OPTION(1),
     {NULL}
 };
 
@@ -1608,6 +1644,7 @@ static const AVOption bandpass_options[] = {
     TRANSFORM_OPTION(DI),
     PRECISION_OPTION(-1),
     BLOCKSIZE_OPTION(0),
+    CASCADE_OPTION(1),
     {NULL}
 };
 
@@ -1623,6 +1660,7 @@ static const AVOption bandreject_options[] = {
     TRANSFORM_OPTION(DI),
     PRECISION_OPTION(-1),
     BLOCKSIZE_OPTION(0),
+    CASCADE_OPTION(1),
     {NULL}
 };
 
@@ -1640,6 +1678,7 @@ static const AVOption lowpass_options[] = {
     TRANSFORM_OPTION(DI),
     PRECISION_OPTION(-1),
     BLOCKSIZE_OPTION(0),
+    CASCADE_OPTION(1),
     {NULL}
 };
 
@@ -1657,6 +1696,7 @@ static const AVOption highpass_options[] = {
     TRANSFORM_OPTION(DI),
     PRECISION_OPTION(-1),
     BLOCKSIZE_OPTION(0),
+    CASCADE_OPTION(1),
     {NULL}
 };
 
@@ -1673,6 +1713,7 @@ static const AVOption allpass_options[] = {
     {"o",     "set filter order", OFFSET(order), AV_OPT_TYPE_INT, {.i64=2}, 1, 2, FLAGS},
     TRANSFORM_OPTION(DI),
     PRECISION_OPTION(-1),
+    CASCADE_OPTION(1),
     {NULL}
 };
 
@@ -1690,6 +1731,7 @@ static const AVOption biquad_options[] = {
     TRANSFORM_OPTION(DI),
     PRECISION_OPTION(-1),
     BLOCKSIZE_OPTION(0),
+    CASCADE_OPTION(1),
     {NULL}
 };
 
@@ -50,8 +50,8 @@ AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
     int channels = link->ch_layout.nb_channels;
     int align = av_cpu_max_align();
 
-    if (ff_frame_pool_audio_reinit(&li->frame_pool, channels, nb_samples,
-                                   link->format, align) < 0)
+    if (ff_frame_pool_audio_reinit(&li->frame_pool, ff_link_frame_pool_cache(li),
+                                   channels, nb_samples, link->format, align) < 0)
         return NULL;
 
     frame = ff_frame_pool_get(&li->frame_pool);
@@ -149,6 +149,11 @@ typedef struct FFFilterGraph {
     void *thread;
     avfilter_execute_func *thread_execute;
     FFFrameQueueGlobal frame_queues;
+
+    /**
+     * Buffer pools shared by the frame pools of all links.
+     */
+    FFFramePoolCache frame_pools;
 } FFFilterGraph;
 
 static inline FFFilterGraph *fffiltergraph(AVFilterGraph *graph)
@@ -156,6 +161,14 @@ static inline FFFilterGraph *fffiltergraph(AVFilterGraph *graph)
     return (FFFilterGraph*)graph;
 }
 
+/**
+ * Get the buffer pool cache a link should allocate its frames from.
+ */
+static inline FFFramePoolCache *ff_link_frame_pool_cache(FilterLinkInternal *li)
+{
+    return li->l.graph ? &fffiltergraph(li->l.graph)->frame_pools : NULL;
+}
+
 /**
  * Update the position of a link in the age heap.
  */
@@ -95,6 +95,11 @@ AVFilterGraph *avfilter_graph_alloc(void)
     av_opt_set_defaults(ret);
     ff_framequeue_global_init(&graph->frame_queues);
 
+    if (ff_frame_pool_cache_init(&graph->frame_pools) < 0) {
+        av_free(graph);
+        return NULL;
+    }
+
     return ret;
 }
 
@@ -129,6 +134,8 @@ void avfilter_graph_free(AVFilterGraph **graphp)
 
     ff_graph_thread_free(graphi);
 
+    ff_frame_pool_cache_uninit(&graphi->frame_pools);
+
     av_freep(&graphi->sink_links);
 
     av_opt_free(graph);
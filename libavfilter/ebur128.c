@@ -46,6 +46,7 @@
 #include <float.h>
 #include <limits.h>
 #include <math.h>               /* You may have to define _USE_MATH_DEFINES if you use MSVC */
+#include <string.h>
 
 #include "libavutil/error.h"
 #include "libavutil/macros.h"
@@ -66,12 +67,17 @@
 #define MINUS_20DB            pow(10.0, -20.0 / 10.0)
 
 struct FFEBUR128StateInternal {
-    /** Filtered audio data (used as ring buffer). */
+    /** Filtered and squared audio data (used as ring buffer). */
     double *audio_data;
     /** Size of audio_data array. */
     size_t audio_data_frames;
     /** Current index for audio_data. */
     size_t audio_data_index;
+    /** Per-channel energy of each 100ms block of audio_data, so that gating
+     *  blocks do not have to be summed again every 100ms. */
+    double *block_energy;
+    /** Scratch buffer holding one energy sum per channel. */
+    double *channel_energy;
     /** How many frames are needed for a gating block. Will correspond to 400ms
      *  of audio at initialization, and 100ms after the first block (75% overlap
      *  as specified in the 2011 revision of BS1770). */
@@ -258,11 +264,16 @@ FFEBUR128State *ff_ebur128_init(unsigned int channels,
                              st->channels * sizeof(*st->d->audio_data));
     CHECK_ERROR(!st->d->audio_data, 0, free_sample_peak)
 
+    st->d->block_energy =
+        (double *) av_calloc(st->d->audio_data_frames / st->d->samples_in_100ms,
+                             st->channels * sizeof(*st->d->block_energy));
+    CHECK_ERROR(!st->d->block_energy, 0, free_audio_data)
+
     ebur128_init_filter(st);
 
     st->d->block_energy_histogram =
         av_mallocz(1000 * sizeof(*st->d->block_energy_histogram));
-    CHECK_ERROR(!st->d->block_energy_histogram, 0, free_audio_data)
+    CHECK_ERROR(!st->d->block_energy_histogram, 0, free_block_energy)
     st->d->short_term_block_energy_histogram =
         av_mallocz(1000 * sizeof(*st->d->short_term_block_energy_histogram));
     CHECK_ERROR(!st->d->short_term_block_energy_histogram, 0,
@@ -277,16 +288,23 @@ FFEBUR128State *ff_ebur128_init(unsigned int channels,
     if (ff_thread_once(&histogram_init, &init_histogram) != 0)
         goto free_short_term_block_energy_histogram;
 
-    st->d->data_ptrs = av_malloc_array(channels, sizeof(*st->d->data_ptrs));
-    CHECK_ERROR(!st->d->data_ptrs, 0,
+    st->d->channel_energy = av_malloc_array(channels, sizeof(*st->d->channel_energy));
+    CHECK_ERROR(!st->d->channel_energy, 0,
                 free_short_term_block_energy_histogram);
 
+    st->d->data_ptrs = av_malloc_array(channels, sizeof(*st->d->data_ptrs));
+    CHECK_ERROR(!st->d->data_ptrs, 0, free_channel_energy);
+
     return st;
 
+free_channel_energy:
+    av_free(st->d->channel_energy);
 free_short_term_block_energy_histogram:
     av_free(st->d->short_term_block_energy_histogram);
 free_block_energy_histogram:
     av_free(st->d->block_energy_histogram);
+free_block_energy:
+    av_free(st->d->block_energy);
 free_audio_data:
     av_free(st->d->audio_data);
 free_sample_peak:
@@ -306,6 +324,8 @@ void ff_ebur128_destroy(FFEBUR128State ** st)
     av_free((*st)->d->block_energy_histogram);
     av_free((*st)->d->short_term_block_energy_histogram);
     av_free((*st)->d->audio_data);
+    av_free((*st)->d->block_energy);
+    av_free((*st)->d->channel_energy);
     av_free((*st)->d->channel_map);
     av_free((*st)->d->sample_peak);
     av_free((*st)->d->data_ptrs);
@@ -314,11 +334,41 @@ void ff_ebur128_destroy(FFEBUR128State ** st)
     *st = NULL;
 }
 
+/* Accumulate the per-channel energy of the 100ms blocks touched by the
+ * frames just written at audio_data_index. */
+static void ebur128_update_block_energy(FFEBUR128State *st, size_t frames)
+{
+    const double *audio_data = st->d->audio_data + st->d->audio_data_index;
+    size_t frame = st->d->audio_data_index / st->channels;
+    size_t i, c;
+
+    while (frames > 0) {
+        size_t offset = frame % st->d->samples_in_100ms;
+        size_t n = FFMIN(frames, st->d->samples_in_100ms - offset);
+        double *block_energy = st->d->block_energy +
+            frame / st->d->samples_in_100ms * st->channels;
+
+        if (!offset)
+            memset(block_energy, 0, st->channels * sizeof(*block_energy));
+        for (i = 0; i < n; ++i) {
+            for (c = 0; c < st->channels; ++c)
+                block_energy[c] += audio_data[c];
+            audio_data += st->channels;
+        }
+        frame  += n;
+        frames -= n;
+    }
+}
+
 #define EBUR128_FILTER(type, scaling_factor)                                       \
 static void ebur128_filter_##type(FFEBUR128State* st, const type** srcs,           \
                                   size_t src_index, size_t frames,                 \
                                   int stride) {                                    \
     double* audio_data = st->d->audio_data + st->d->audio_data_index;              \
+    const double b0 = st->d->b[0], b1 = st->d->b[1], b2 = st->d->b[2];             \
+    const double b3 = st->d->b[3], b4 = st->d->b[4];                               \
+    const double a1 = st->d->a[1], a2 = st->d->a[2];                               \
+    const double a3 = st->d->a[3], a4 = st->d->a[4];                               \
     size_t i, c;                                                                   \
                                                                                    \
     if ((st->mode & FF_EBUR128_MODE_SAMPLE_PEAK) == FF_EBUR128_MODE_SAMPLE_PEAK) { \
@@ -337,31 +387,35 @@ static void ebur128_filter_##type(FFEBUR128State* st, const type** srcs,
         }                                                                          \
     }                                                                              \
     for (c = 0; c < st->channels; ++c) {                                           \
+        const type *src = srcs[c] + src_index;                                     \
+        double *dst = audio_data + c;                                              \
+        double *v, v1, v2, v3, v4;                                                 \
         int ci = st->d->channel_map[c] - 1;                                        \
         if (ci < 0) continue;                                                      \
         else if (ci == FF_EBUR128_DUAL_MONO - 1) ci = 0; /*dual mono */            \
+        /* keep the filter state in registers, dst may alias st->d */              \
+        v  = st->d->v[ci];                                                         \
+        v1 = v[1];                                                                 \
+        v2 = v[2];                                                                 \
+        v3 = v[3];                                                                 \
+        v4 = v[4];                                                                 \
         for (i = 0; i < frames; ++i) {                                             \
-            st->d->v[ci][0] = (double) (srcs[c][src_index + i * stride] / scaling_factor) \
-                         - st->d->a[1] * st->d->v[ci][1]                           \
-                         - st->d->a[2] * st->d->v[ci][2]                           \
-                         - st->d->a[3] * st->d->v[ci][3]                           \
-                         - st->d->a[4] * st->d->v[ci][4];                          \
-            audio_data[i * st->channels + c] =                                     \
-                           st->d->b[0] * st->d->v[ci][0]                           \
-                         + st->d->b[1] * st->d->v[ci][1]                           \
-                         + st->d->b[2] * st->d->v[ci][2]                           \
-                         + st->d->b[3] * st->d->v[ci][3]                           \
-                         + st->d->b[4] * st->d->v[ci][4];                          \
-            st->d->v[ci][4] = st->d->v[ci][3];                                     \
-            st->d->v[ci][3] = st->d->v[ci][2];                                     \
-            st->d->v[ci][2] = st->d->v[ci][1];                                     \
-            st->d->v[ci][1] = st->d->v[ci][0];                                     \
+            const double v0 = (double) (src[i * stride] / scaling_factor)          \
+                            - a1 * v1 - a2 * v2 - a3 * v3 - a4 * v4;               \
+            const double y  = b0 * v0 + b1 * v1 + b2 * v2 + b3 * v3 + b4 * v4;     \
+            dst[i * st->channels] = y * y;                                         \
+            v4 = v3;                                                               \
+            v3 = v2;                                                               \
+            v2 = v1;                                                               \
+            v1 = v0;                                                               \
         }                                                                          \
-        st->d->v[ci][4] = fabs(st->d->v[ci][4]) < DBL_MIN ? 0.0 : st->d->v[ci][4]; \
-        st->d->v[ci][3] = fabs(st->d->v[ci][3]) < DBL_MIN ? 0.0 : st->d->v[ci][3]; \
-        st->d->v[ci][2] = fabs(st->d->v[ci][2]) < DBL_MIN ? 0.0 : st->d->v[ci][2]; \
-        st->d->v[ci][1] = fabs(st->d->v[ci][1]) < DBL_MIN ? 0.0 : st->d->v[ci][1]; \
+        v[0] = v1;                                                                 \
+        v[4] = fabs(v4) < DBL_MIN ? 0.0 : v4;                                      \
+        v[3] = fabs(v3) < DBL_MIN ? 0.0 : v3;                                      \
+        v[2] = fabs(v2) < DBL_MIN ? 0.0 : v2;                                      \
+        v[1] = fabs(v1) < DBL_MIN ? 0.0 : v1;                                      \
     }                                                                              \
+    ebur128_update_block_energy(st, frames);                                       \
 }
 EBUR128_FILTER(double, 1.0)
 
@@ -394,34 +448,41 @@ static void ebur128_calc_gating_block(FFEBUR128State * st,
 {
     size_t i, c;
     double sum = 0.0;
-    double channel_sum;
+    double *channel_energy = st->d->channel_energy;
+    const size_t nb_blocks = st->d->audio_data_frames / st->d->samples_in_100ms;
+    size_t blocks = frames_per_block / st->d->samples_in_100ms;
+    size_t end = st->d->audio_data_index / st->channels;
+    size_t block = end / st->d->samples_in_100ms;
+    size_t offset = end % st->d->samples_in_100ms;
+
+    memset(channel_energy, 0, st->channels * sizeof(*channel_energy));
+    if (offset) {
+        /* The current block is only partially filled, its energy so far is
+         * already accumulated, but only the tail of the oldest block is part
+         * of the interval. */
+        const double *audio_data = st->d->audio_data +
+            (((block + nb_blocks - blocks) % nb_blocks) *
+             st->d->samples_in_100ms + offset) * st->channels;
+        for (i = offset; i < st->d->samples_in_100ms; ++i) {
+            for (c = 0; c < st->channels; ++c)
+                channel_energy[c] += audio_data[c];
+            audio_data += st->channels;
+        }
+        for (c = 0; c < st->channels; ++c)
+            channel_energy[c] += st->d->block_energy[block * st->channels + c];
+        blocks--;
+    }
+    for (i = 1; i <= blocks; ++i) {
+        const double *block_energy = st->d->block_energy +
+            (block + nb_blocks - i) % nb_blocks * st->channels;
+        for (c = 0; c < st->channels; ++c)
+            channel_energy[c] += block_energy[c];
+    }
+
     for (c = 0; c < st->channels; ++c) {
+        double channel_sum = channel_energy[c];
         if (st->d->channel_map[c] == FF_EBUR128_UNUSED)
             continue;
-        channel_sum = 0.0;
-        if (st->d->audio_data_index < frames_per_block * st->channels) {
-            for (i = 0; i < st->d->audio_data_index / st->channels; ++i) {
-                channel_sum += st->d->audio_data[i * st->channels + c] *
-                    st->d->audio_data[i * st->channels + c];
-            }
-            for (i = st->d->audio_data_frames -
-                 (frames_per_block -
-                  st->d->audio_data_index / st->channels);
-                 i < st->d->audio_data_frames; ++i) {
-                channel_sum += st->d->audio_data[i * st->channels + c] *
-                    st->d->audio_data[i * st->channels + c];
-            }
-        } else {
-            for (i =
-                 st->d->audio_data_index / st->channels - frames_per_block;
-                 i < st->d->audio_data_index / st->channels; ++i) {
-                channel_sum +=
-                    st->d->audio_data[i * st->channels +
-                                      c] * st->d->audio_data[i *
-                                                             st->channels +
-                                                             c];
-            }
-        }
         if (st->d->channel_map[c] == FF_EBUR128_Mp110 ||
             st->d->channel_map[c] == FF_EBUR128_Mm110 ||
             st->d->channel_map[c] == FF_EBUR128_Mp060 ||
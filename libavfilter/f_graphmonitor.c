@@ -28,6 +28,7 @@
 #include "libavutil/xga_font_data.h"
 #include "audio.h"
 #include "avfilter.h"
+#include "avfilter_internal.h"
 #include "filters.h"
 #include "formats.h"
 #include "video.h"
@@ -90,6 +91,7 @@ enum {
     FLAG_FC_DELTA = 1 << 14,
     FLAG_SC_DELTA = 1 << 15,
     FLAG_DISABLED = 1 << 16,
+    FLAG_POOL  = 1 << 17,
 };
 
 #define OFFSET(x) offsetof(GraphMonitorContext, x)
@@ -129,6 +131,7 @@ static const AVOption graphmonitor_options[] = {
         { "sample_count_out", NULL, 0, AV_OPT_TYPE_CONST, {.i64=FLAG_SCIN},    0, 0, VFR, .unit = "flags" },
         { "sample_count_delta",NULL,0, AV_OPT_TYPE_CONST, {.i64=FLAG_SC_DELTA},0, 0, VFR, .unit = "flags" },
         { "disabled",         NULL, 0, AV_OPT_TYPE_CONST, {.i64=FLAG_DISABLED},0, 0, VFR, .unit = "flags" },
+        { "pool",             NULL, 0, AV_OPT_TYPE_CONST, {.i64=FLAG_POOL},    0, 0, VFR, .unit = "flags" },
     { "rate", "set video rate", OFFSET(frame_rate), AV_OPT_TYPE_VIDEO_RATE, {.str = "25"}, 0, INT_MAX, VF },
     { "r",    "set video rate", OFFSET(frame_rate), AV_OPT_TYPE_VIDEO_RATE, {.str = "25"}, 0, INT_MAX, VF },
     { NULL }
@@ -358,6 +361,17 @@ static int draw_items(AVFilterContext *ctx,
         drawtext(out, xpos, ypos, buffer, len, s->white);
         xpos += len * 8;
     }
+    if (flags & FLAG_POOL) {
+        uint64_t requests, allocs;
+
+        ff_frame_pool_get_stats(&ff_link_internal(l)->frame_pool, &requests, &allocs);
+        if (!(mode & MODE_NOZERO) || requests) {
+            len = snprintf(buffer, sizeof(buffer)-1, " | pool hit: %"PRIu64" miss: %"PRIu64,
+                           requests - allocs, allocs);
+            drawtext(out, xpos, ypos, buffer, len, s->white);
+            xpos += len * 8;
+        }
+    }
     if ((flags & FLAG_EOF) && ff_outlink_get_status(l)) {
         len = snprintf(buffer, sizeof(buffer)-1, " | eof");
         drawtext(out, xpos, ypos, buffer, len, s->blue);
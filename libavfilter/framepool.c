@@ -18,6 +18,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
+
 #include "framepool.h"
 #include "libavutil/avassert.h"
 #include "libavutil/avutil.h"
@@ -28,6 +30,130 @@
 #include "libavutil/mem.h"
 #include "libavutil/pixfmt.h"
 
+struct FFSizeClassPool {
+    AVBufferPool *pool;
+    size_t size;
+    int zeroed;
+    /* number of frame pools using this one, protected by the cache lock */
+    unsigned nb_users;
+
+    atomic_uint_least64_t nb_requests;
+    atomic_uint_least64_t nb_allocs;
+};
+
+/* Round large buffers up to whole pages, so that planes which only differ by
+ * a few bytes of padding end up in the same pool. */
+#define SIZE_CLASS_ALIGN 4096
+
+static size_t size_class(size_t size)
+{
+    if (size < SIZE_CLASS_ALIGN || size > SIZE_MAX - SIZE_CLASS_ALIGN)
+        return size;
+    return FFALIGN(size, SIZE_CLASS_ALIGN);
+}
+
+static AVBufferRef *size_class_alloc(void *opaque, size_t size)
+{
+    FFSizeClassPool *scp = opaque;
+
+    atomic_fetch_add_explicit(&scp->nb_allocs, 1, memory_order_relaxed);
+    return scp->zeroed ? av_buffer_allocz(size) : av_buffer_alloc(size);
+}
+
+static FFSizeClassPool *size_class_pool_get(FFFramePoolCache *cache,
+                                            size_t size, int zeroed)
+{
+    FFSizeClassPool *scp = NULL;
+
+    size = size_class(size);
+
+    if (cache) {
+        ff_mutex_lock(&cache->lock);
+        for (int i = 0; i < cache->nb_pools; i++) {
+            if (cache->pools[i]->size == size && cache->pools[i]->zeroed == zeroed) {
+                scp = cache->pools[i];
+                scp->nb_users++;
+                goto end;
+            }
+        }
+    }
+
+    scp = av_mallocz(sizeof(*scp));
+    if (!scp)
+        goto end;
+
+    scp->size     = size;
+    scp->zeroed   = zeroed;
+    scp->nb_users = 1;
+    atomic_init(&scp->nb_requests, 0);
+    atomic_init(&scp->nb_allocs, 0);
+
+    scp->pool = av_buffer_pool_init2(size, scp, size_class_alloc, NULL);
+    if (!scp->pool) {
+        av_freep(&scp);
+        goto end;
+    }
+
+    if (cache && av_dynarray_add_nofree(&cache->pools, &cache->nb_pools, scp) < 0) {
+        av_buffer_pool_uninit(&scp->pool);
+        av_freep(&scp);
+    }
+
+end:
+    if (cache)
+        ff_mutex_unlock(&cache->lock);
+    return scp;
+}
+
+static void size_class_pool_release(FFFramePoolCache *cache, FFSizeClassPool **pscp)
+{
+    FFSizeClassPool *scp = *pscp;
+
+    if (!scp)
+        return;
+    *pscp = NULL;
+
+    if (cache)
+        ff_mutex_lock(&cache->lock);
+
+    if (!--scp->nb_users) {
+        if (cache) {
+            for (int i = 0; i < cache->nb_pools; i++) {
+                if (cache->pools[i] == scp) {
+                    cache->pools[i] = cache->pools[--cache->nb_pools];
+                    break;
+                }
+            }
+        }
+        /* buffers still in use keep the AVBufferPool alive, but they never
+         * call back into scp again */
+        av_buffer_pool_uninit(&scp->pool);
+        av_free(scp);
+    }
+
+    if (cache)
+        ff_mutex_unlock(&cache->lock);
+}
+
+static AVBufferRef *size_class_pool_request(FFSizeClassPool *scp)
+{
+    atomic_fetch_add_explicit(&scp->nb_requests, 1, memory_order_relaxed);
+    return av_buffer_pool_get(scp->pool);
+}
+
+av_cold int ff_frame_pool_cache_init(FFFramePoolCache *cache)
+{
+    *cache = (FFFramePoolCache){ 0 };
+    return ff_mutex_init(&cache->lock, NULL) ? AVERROR(ENOMEM) : 0;
+}
+
+av_cold void ff_frame_pool_cache_uninit(FFFramePoolCache *cache)
+{
+    av_assert0(!cache->nb_pools);
+    av_freep(&cache->pools);
+    ff_mutex_destroy(&cache->lock);
+}
+
 static av_cold int frame_pool_video_init(int width, int height,
                                          enum AVPixelFormat format,
                                          int align, FFFramePool *pool)
@@ -35,6 +161,7 @@ static av_cold int frame_pool_video_init(int width, int height,
     int ret;
 
     *pool = (FFFramePool) {
+        .cache = pool->cache,
         .type = AVMEDIA_TYPE_VIDEO,
         .width = width,
         .height = height,
@@ -65,12 +192,12 @@ static av_cold int frame_pool_video_init(int width, int height,
         goto fail;
 
     for (int i = 0; i < 4 && sizes[i]; i++) {
-        if (sizes[i] > SIZE_MAX - align)
+        if (sizes[i] > SIZE_MAX - align) {
+            ret = AVERROR(EINVAL);
             goto fail;
-        pool->pools[i] = av_buffer_pool_init(sizes[i] + align,
-                                             CONFIG_MEMORY_POISONING
-                                                 ? NULL
-                                                 : av_buffer_allocz);
+        }
+        pool->pools[i] = size_class_pool_get(pool->cache, sizes[i] + align,
+                                             !CONFIG_MEMORY_POISONING);
         if (!pool->pools[i]) {
             ret = AVERROR(ENOMEM);
             goto fail;
@@ -93,6 +220,7 @@ static av_cold int frame_pool_audio_init(int channels, int nb_samples,
     int planar = av_sample_fmt_is_planar(format);
 
     *pool = (FFFramePool) {
+        .cache = pool->cache,
         .type = AVMEDIA_TYPE_AUDIO,
         .planes = planar ? channels : 1,
         .channels = channels,
@@ -111,8 +239,7 @@ static av_cold int frame_pool_audio_init(int channels, int nb_samples,
         goto fail;
     }
 
-    pool->pools[0] = av_buffer_pool_init(pool->linesize[0] + align,
-                                         av_buffer_allocz);
+    pool->pools[0] = size_class_pool_get(pool->cache, pool->linesize[0] + align, 1);
     if (!pool->pools[0]) {
         ret = AVERROR(ENOMEM);
         goto fail;
@@ -148,7 +275,7 @@ AVFrame *ff_frame_pool_get(FFFramePool *pool)
             if (!pool->pools[i])
                 break;
 
-            frame->buf[i] = av_buffer_pool_get(pool->pools[i]);
+            frame->buf[i] = size_class_pool_request(pool->pools[i]);
             if (!frame->buf[i])
                 goto fail;
 
@@ -187,14 +314,14 @@ AVFrame *ff_frame_pool_get(FFFramePool *pool)
         }
 
         for (int i = 0; i < FFMIN(pool->planes, AV_NUM_DATA_POINTERS); i++) {
-            frame->buf[i] = av_buffer_pool_get(pool->pools[0]);
+            frame->buf[i] = size_class_pool_request(pool->pools[0]);
             if (!frame->buf[i])
                 goto fail;
             frame->extended_data[i] = frame->data[i] =
                 (uint8_t *)FFALIGN((uintptr_t)frame->buf[i]->data, pool->align);
         }
         for (int i = 0; i < frame->nb_extended_buf; i++) {
-            frame->extended_buf[i] = av_buffer_pool_get(pool->pools[0]);
+            frame->extended_buf[i] = size_class_pool_request(pool->pools[0]);
             if (!frame->extended_buf[i])
                 goto fail;
             frame->extended_data[i + AV_NUM_DATA_POINTERS] =
@@ -212,21 +339,46 @@ fail:
     return NULL;
 }
 
+AVBufferRef *ff_frame_pool_get_plane_buffer(FFFramePool *pool, int plane)
+{
+    av_assert0(plane >= 0 && plane < FF_ARRAY_ELEMS(pool->pools));
+    if (!pool->pools[plane])
+        return NULL;
+    return size_class_pool_request(pool->pools[plane]);
+}
+
 av_cold void ff_frame_pool_uninit(FFFramePool *pool)
 {
     for (int i = 0; i < 4; i++)
-        av_buffer_pool_uninit(&pool->pools[i]);
+        size_class_pool_release(pool->cache, &pool->pools[i]);
 
     memset(pool, 0, sizeof(*pool));
 }
 
+void ff_frame_pool_get_stats(const FFFramePool *pool,
+                             uint64_t *requests, uint64_t *allocs)
+{
+    *requests = *allocs = 0;
+    for (int i = 0; i < 4; i++) {
+        if (!pool->pools[i])
+            continue;
+        *requests += atomic_load_explicit(&pool->pools[i]->nb_requests, memory_order_relaxed);
+        *allocs   += atomic_load_explicit(&pool->pools[i]->nb_allocs,   memory_order_relaxed);
+    }
+}
+
 int ff_frame_pool_video_reinit(FFFramePool *pool,
+                               FFFramePoolCache *cache,
                                int width,
                                int height,
                                enum AVPixelFormat format,
                                int align)
 {
+    FFFramePool new_pool = { .cache = cache };
+    int ret;
+
     if (pool->type == AVMEDIA_TYPE_VIDEO &&
+        pool->cache == cache &&
         pool->pix_fmt == format &&
         FFALIGN(pool->width,  pool->align) == FFALIGN(width,  align) &&
         FFALIGN(pool->height, pool->align) == FFALIGN(height, align) &&
@@ -237,17 +389,29 @@ int ff_frame_pool_video_reinit(FFFramePool *pool,
         return 0;
     }
 
+    /* set up the new pool before dropping the old one, so buffer pools
+     * shared with other links or reused by the new geometry survive */
+    ret = frame_pool_video_init(width, height, format, align, &new_pool);
+    if (ret < 0)
+        return ret;
+
     ff_frame_pool_uninit(pool);
-    return frame_pool_video_init(width, height, format, align, pool);
+    *pool = new_pool;
+    return 0;
 }
 
 int ff_frame_pool_audio_reinit(FFFramePool *pool,
+                               FFFramePoolCache *cache,
                                int channels,
                                int nb_samples,
                                enum AVSampleFormat format,
                                int align)
 {
+    FFFramePool new_pool = { .cache = cache };
+    int ret;
+
     if (pool->type == AVMEDIA_TYPE_AUDIO &&
+        pool->cache == cache &&
         pool->sample_fmt == format &&
         pool->channels == channels &&
         pool->nb_samples == nb_samples &&
@@ -256,6 +420,11 @@ int ff_frame_pool_audio_reinit(FFFramePool *pool,
         return 0;
     }
 
+    ret = frame_pool_audio_init(channels, nb_samples, format, align, &new_pool);
+    if (ret < 0)
+        return ret;
+
     ff_frame_pool_uninit(pool);
-    return frame_pool_audio_init(channels, nb_samples, format, align, pool);
+    *pool = new_pool;
+    return 0;
 }
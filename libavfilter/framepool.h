@@ -21,9 +21,25 @@
 #ifndef AVFILTER_FRAMEPOOL_H
 #define AVFILTER_FRAMEPOOL_H
 
+#include <stdint.h>
+
 #include "libavutil/buffer.h"
 #include "libavutil/frame.h"
 #include "libavutil/internal.h"
+#include "libavutil/thread.h"
+
+typedef struct FFSizeClassPool FFSizeClassPool;
+
+/**
+ * Set of buffer pools, one per buffer size class, shared by all the frame
+ * pools created with it. A filter graph owns one, so that links with the
+ * same geometry draw from the same buffers instead of each keeping its own.
+ */
+typedef struct FFFramePoolCache {
+    AVMutex lock;
+    FFSizeClassPool **pools;
+    int nb_pools;
+} FFFramePoolCache;
 
 /**
  * Frame pool. This structure must be initialized with
@@ -49,16 +65,32 @@ typedef struct FFFramePool {
     /* common */
     int align;
     int linesize[4];
-    AVBufferPool *pools[4]; /* for audio, only pools[0] is used */
+    FFSizeClassPool *pools[4]; /* for audio, only pools[0] is used */
+    FFFramePoolCache *cache;
 
 } FFFramePool;
 
+/**
+ * Initialize a frame pool cache.
+ *
+ * @return 0 on success, a negative AVERROR otherwise.
+ */
+int ff_frame_pool_cache_init(FFFramePoolCache *cache);
+
+/**
+ * Free a frame pool cache. All frame pools using it must have been
+ * uninitialized before; frames allocated from them may still be in use.
+ */
+void ff_frame_pool_cache_uninit(FFFramePoolCache *cache);
+
 /**
  * Recreate the video frame pool if its current configuration differs from the
  * provided configuration. If initialization fails, the old pool is kept
  * unchanged.
  *
  * @param pool pointer to the frame pool to be (re)initialized
+ * @param cache cache to take the buffer pools from, or NULL to use private
+ *              buffer pools
  * @param width width of each frame in this pool
  * @param height height of each frame in this pool
  * @param format format of each frame in this pool
@@ -66,6 +98,7 @@ typedef struct FFFramePool {
  * @return 0 on success, a negative AVERROR otherwise.
  */
 int ff_frame_pool_video_reinit(FFFramePool *pool,
+                               FFFramePoolCache *cache,
                                int width,
                                int height,
                                enum AVPixelFormat format,
@@ -77,6 +110,8 @@ int ff_frame_pool_video_reinit(FFFramePool *pool,
  * unchanged.
  *
  * @param pool pointer to the frame pool to be (re)initialized
+ * @param cache cache to take the buffer pools from, or NULL to use private
+ *              buffer pools
  * @param channels channels of each frame in this pool
  * @param nb_samples number of samples of each frame in this pool
  * @param format format of each frame in this pool
@@ -84,6 +119,7 @@ int ff_frame_pool_video_reinit(FFFramePool *pool,
  * @return 0 on success, a negative AVERROR otherwise.
  */
 int ff_frame_pool_audio_reinit(FFFramePool *pool,
+                               FFFramePoolCache *cache,
                                int channels,
                                int nb_samples,
                                enum AVSampleFormat format,
@@ -105,5 +141,23 @@ void ff_frame_pool_uninit(FFFramePool *pool);
  */
 AVFrame *ff_frame_pool_get(FFFramePool *pool);
 
+/**
+ * Get a single buffer for the given plane of a video frame pool, reusing old
+ * buffers when available. The buffer is not aligned to the pool alignment.
+ *
+ * @return a new buffer reference on success, NULL on error.
+ */
+AVBufferRef *ff_frame_pool_get_plane_buffer(FFFramePool *pool, int plane);
+
+/**
+ * Get the usage statistics of the buffer pools backing a frame pool. When the
+ * buffer pools are shared, the statistics include the other users.
+ *
+ * @param requests total number of buffers requested from the pools
+ * @param allocs number of those requests that needed a new allocation
+ */
+void ff_frame_pool_get_stats(const FFFramePool *pool,
+                             uint64_t *requests, uint64_t *allocs);
+
 
 #endif /* AVFILTER_FRAMEPOOL_H */
@@ -33,6 +33,7 @@
 #include "libavutil/pixdesc.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/mathematics.h"
+#include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/timestamp.h"
 #include "filters.h"
@@ -82,6 +83,8 @@ static av_cold void uninit(AVFilterContext *ctx)
     OverlayContext *s = ctx->priv;
 
     ff_framesync_uninit(&s->fs);
+    av_freep(&s->coverage);
+    av_buffer_unref(&s->coverage_buf);
     av_expr_free(s->x_pexpr); s->x_pexpr = NULL;
     av_expr_free(s->y_pexpr); s->y_pexpr = NULL;
 }
@@ -364,6 +367,20 @@ static int config_output(AVFilterLink *outlink)
 #define PTR_ADD(TYPE, ptr, byte_addend) ((TYPE*)((uint8_t*)ptr + (byte_addend)))
 #define CPTR_ADD(TYPE, ptr, byte_addend) ((const TYPE*)((const uint8_t*)ptr + (byte_addend)))
 
+// width in overlay alpha samples of the tiles classified by update_coverage()
+#define COVERAGE_TILE 64
+
+enum CoverageState {
+    COVERAGE_MIXED,
+    COVERAGE_TRANSPARENT,
+    COVERAGE_OPAQUE,
+};
+
+static av_always_inline int coverage_state(const uint8_t *cov0, const uint8_t *cov1, int t)
+{
+    return cov0[t] == cov1[t] ? cov0[t] : COVERAGE_MIXED;
+}
+
 /**
  * Blend image in src to destination buffer dst at position (x, y).
  */
@@ -493,6 +510,9 @@ static av_always_inline void blend_plane_##depth##_##nbits##bits(AVFilterContext
                       + dst_offset;                                                                        \
     const uint8_t *ap = src->data[3] + (slice_start << vsub) * src->linesize[3];                           \
     const uint8_t *dap = main_straight ? dst->data[3] + ((yp + slice_start) << vsub) * dst->linesize[3] : NULL; \
+    /* transparent and opaque tiles only reduce to a no-op or a copy for straight overlays */              \
+    const uint8_t *cov = overlay_straight && octx->coverage_skip ? octx->coverage : NULL;                  \
+    const int tile_w = COVERAGE_TILE >> hsub;                                                              \
                                                                                                            \
     for (int j = slice_start; j < slice_end; ++j) {                                                        \
         int k = kmin;                                                                                      \
@@ -500,77 +520,108 @@ static av_always_inline void blend_plane_##depth##_##nbits##bits(AVFilterContext
         const T  *a = (const T *)ap + (k << hsub);                                                         \
         const T *da = main_straight ? (T *)dap + ((xp + k) << hsub) : NULL;                                \
         T *d  = (T *)(dp + (xp + k) * dst_step);                                                           \
+        const uint8_t *cov0 = cov ? cov + (j << vsub) * octx->coverage_tiles : NULL;                       \
+        const uint8_t *cov1 = cov && vsub && (j << vsub) + 1 < src_h ?                                     \
+                              cov0 + octx->coverage_tiles : cov0;                                          \
                                                                                                            \
-        if (nbits == 8 && ((vsub && j+1 < src_hp) || !vsub) && octx->blend_row[i]) {                       \
-            int c = octx->blend_row[i]((uint8_t*)d, (uint8_t*)da, (uint8_t*)s,                             \
-                    (uint8_t*)a, kmax - k, src->linesize[3]);                                              \
+        while (k < kmax) {                                                                                 \
+            int kend = kmax;                                                                               \
                                                                                                            \
-            s += c;                                                                                        \
-            d  = PTR_ADD(T, d, dst_step * c);                                                              \
-            if (main_straight)                                                                             \
-                da += (1 << hsub) * c;                                                                     \
-            a += (1 << hsub) * c;                                                                          \
-            k += c;                                                                                        \
-        }                                                                                                  \
-        for (; k < kmax; k++) {                                                                            \
-            int alpha_v, alpha_h, alpha;                                                                   \
+            if (cov) {                                                                                     \
+                const int t = k / tile_w;                                                                  \
+                const int state = coverage_state(cov0, cov1, t);                                           \
+                                                                                                           \
+                kend = FFMIN(kmax, (t + 1) * tile_w);                                                      \
+                if (state != COVERAGE_MIXED) {                                                             \
+                    const int n = kend - k;                                                                \
+                    if (state == COVERAGE_OPAQUE) {                                                        \
+                        if (dst_step == sizeof(T))                                                         \
+                            memcpy(d, s, n * sizeof(T));                                                   \
+                        else                                                                               \
+                            for (int m = 0; m < n; m++)                                                    \
+                                *PTR_ADD(T, d, m * dst_step) = s[m];                                       \
+                    }                                                                                      \
+                    s += n;                                                                                \
+                    d  = PTR_ADD(T, d, dst_step * n);                                                      \
+                    if (main_straight)                                                                     \
+                        da += n << hsub;                                                                   \
+                    a += n << hsub;                                                                        \
+                    k  = kend;                                                                             \
+                    continue;                                                                              \
+                }                                                                                          \
+            }                                                                                              \
+                                                                                                           \
+            if (nbits == 8 && ((vsub && j+1 < src_hp) || !vsub) && octx->blend_row[i]) {                   \
+                int c = octx->blend_row[i]((uint8_t*)d, (uint8_t*)da, (uint8_t*)s,                         \
+                        (uint8_t*)a, kend - k, src->linesize[3]);                                          \
+                                                                                                           \
+                s += c;                                                                                    \
+                d  = PTR_ADD(T, d, dst_step * c);                                                          \
+                if (main_straight)                                                                         \
+                    da += (1 << hsub) * c;                                                                 \
+                a += (1 << hsub) * c;                                                                      \
+                k += c;                                                                                    \
+            }                                                                                              \
+            for (; k < kend; k++) {                                                                        \
+                int alpha_v, alpha_h, alpha;                                                               \
                                                                                                            \
-            /* average alpha for color components, improve quality */                                      \
-            if (hsub && vsub && j+1 < src_hp && k+1 < src_wp) {                                            \
-                const T *next_line = CPTR_ADD(T, a, src->linesize[3]);                                     \
-                alpha = (a[0] + next_line[0] +                                                             \
-                         a[1] + next_line[1]) >> 2;                                                        \
-            } else if (hsub || vsub) {                                                                     \
-                alpha_h = hsub && k+1 < src_wp ?                                                           \
-                    (a[0] + a[1]) >> 1 : a[0];                                                             \
-                alpha_v = vsub && j+1 < src_hp ?                                                           \
-                    (a[0] + *CPTR_ADD(T, a, src->linesize[3])) >> 1 : a[0];                                \
-                alpha = (alpha_v + alpha_h) >> 1;                                                          \
-            } else                                                                                         \
-                alpha = a[0];                                                                              \
-            /* if the main channel has an alpha channel, alpha has to be calculated */                     \
-            /* to create an un-premultiplied (straight) alpha value */                                     \
-            if (main_straight && alpha != 0 && alpha != max) {                                             \
                 /* average alpha for color components, improve quality */                                  \
-                uint8_t alpha_d;                                                                           \
                 if (hsub && vsub && j+1 < src_hp && k+1 < src_wp) {                                        \
-                    const T *next_line = CPTR_ADD(T, da, dst->linesize[3]);                                \
-                    alpha_d = (da[0] + next_line[0] +                                                      \
-                               da[1] + next_line[1]) >> 2;                                                 \
+                    const T *next_line = CPTR_ADD(T, a, src->linesize[3]);                                 \
+                    alpha = (a[0] + next_line[0] +                                                         \
+                             a[1] + next_line[1]) >> 2;                                                    \
                 } else if (hsub || vsub) {                                                                 \
                     alpha_h = hsub && k+1 < src_wp ?                                                       \
-                        (da[0] + da[1]) >> 1 : da[0];                                                      \
+                        (a[0] + a[1]) >> 1 : a[0];                                                         \
                     alpha_v = vsub && j+1 < src_hp ?                                                       \
-                        (da[0] + *CPTR_ADD(T, da, dst->linesize[3])) >> 1 : da[0];                         \
-                    alpha_d = (alpha_v + alpha_h) >> 1;                                                    \
+                        (a[0] + *CPTR_ADD(T, a, src->linesize[3])) >> 1 : a[0];                            \
+                    alpha = (alpha_v + alpha_h) >> 1;                                                      \
                 } else                                                                                     \
-                    alpha_d = da[0];                                                                       \
-                alpha = UNPREMULTIPLY_ALPHA(alpha, alpha_d);                                               \
-            }                                                                                              \
-            if (overlay_straight) {                                                                        \
-                if (nbits > 8)                                                                             \
-                   *d = (*d * (max - alpha) + *s * alpha) / max;                                           \
-                else                                                                                       \
-                    *d = FAST_DIV255(*d * (255 - alpha) + *s * alpha);                                     \
-            } else {                                                                                       \
-                if (nbits > 8) {                                                                           \
-                    if (i && yuv)                                                                          \
-                        *d = av_clip((*d * (max - alpha) + *s * alpha) / max + *s - mid, -mid, mid) + mid; \
+                    alpha = a[0];                                                                          \
+                /* if the main channel has an alpha channel, alpha has to be calculated */                 \
+                /* to create an un-premultiplied (straight) alpha value */                                 \
+                if (main_straight && alpha != 0 && alpha != max) {                                         \
+                    /* average alpha for color components, improve quality */                              \
+                    uint8_t alpha_d;                                                                       \
+                    if (hsub && vsub && j+1 < src_hp && k+1 < src_wp) {                                    \
+                        const T *next_line = CPTR_ADD(T, da, dst->linesize[3]);                            \
+                        alpha_d = (da[0] + next_line[0] +                                                  \
+                                   da[1] + next_line[1]) >> 2;                                             \
+                    } else if (hsub || vsub) {                                                             \
+                        alpha_h = hsub && k+1 < src_wp ?                                                   \
+                            (da[0] + da[1]) >> 1 : da[0];                                                  \
+                        alpha_v = vsub && j+1 < src_hp ?                                                   \
+                            (da[0] + *CPTR_ADD(T, da, dst->linesize[3])) >> 1 : da[0];                     \
+                        alpha_d = (alpha_v + alpha_h) >> 1;                                                \
+                    } else                                                                                 \
+                        alpha_d = da[0];                                                                   \
+                    alpha = UNPREMULTIPLY_ALPHA(alpha, alpha_d);                                           \
+                }                                                                                          \
+                if (overlay_straight) {                                                                    \
+                    if (nbits > 8)                                                                         \
+                       *d = (*d * (max - alpha) + *s * alpha) / max;                                       \
                     else                                                                                   \
-                        *d = av_clip_uintp2((*d * (max - alpha) + *s * alpha) / max + *s - (16<<(nbits-8)),\
-                                                                                                    nbits);\
+                        *d = FAST_DIV255(*d * (255 - alpha) + *s * alpha);                                 \
                 } else {                                                                                   \
-                    if (i && yuv)                                                                          \
-                        *d = av_clip(FAST_DIV255((*d - mid) * (max - alpha)) + *s - mid, -mid, mid) + mid; \
-                    else                                                                                   \
-                        *d = av_clip_uint8(FAST_DIV255(*d * (255 - alpha)) + *s - 16);                     \
+                    if (nbits > 8) {                                                                       \
+                        if (i && yuv)                                                                      \
+                            *d = av_clip((*d * (max - alpha) + *s * alpha) / max + *s - mid, -mid, mid) + mid; \
+                        else                                                                               \
+                            *d = av_clip_uintp2((*d * (max - alpha) + *s * alpha) / max + *s - (16<<(nbits-8)), \
+                                                                                                        nbits); \
+                    } else {                                                                               \
+                        if (i && yuv)                                                                      \
+                            *d = av_clip(FAST_DIV255((*d - mid) * (max - alpha)) + *s - mid, -mid, mid) + mid; \
+                        else                                                                               \
+                            *d = av_clip_uint8(FAST_DIV255(*d * (255 - alpha)) + *s - 16);                 \
+                    }                                                                                      \
                 }                                                                                          \
+                s++;                                                                                       \
+                d  = PTR_ADD(T, d, dst_step);                                                              \
+                if (main_straight)                                                                         \
+                    da += 1 << hsub;                                                                       \
+                a += 1 << hsub;                                                                            \
             }                                                                                              \
-            s++;                                                                                           \
-            d  = PTR_ADD(T, d, dst_step);                                                                  \
-            if (main_straight)                                                                             \
-                da += 1 << hsub;                                                                           \
-            a += 1 << hsub;                                                                                \
         }                                                                                                  \
         dp += dst->linesize[dst_plane];                                                                    \
         sp += src->linesize[i];                                                                            \
@@ -583,7 +634,8 @@ DEFINE_BLEND_PLANE(8,  uint8_t,  8)
 DEFINE_BLEND_PLANE(16, uint16_t, 10)
 
 #define DEFINE_ALPHA_COMPOSITE(depth, T, nbits)                                                            \
-static inline void alpha_composite_##depth##_##nbits##bits(const AVFrame *src, const AVFrame *dst,         \
+static inline void alpha_composite_##depth##_##nbits##bits(const OverlayContext *octx,                   \
+                                   const AVFrame *src, const AVFrame *dst,                                 \
                                    int src_w, int src_h,                                                   \
                                    int dst_w, int dst_h,                                                   \
                                    int x, int y, int main_straight,                                        \
@@ -599,28 +651,48 @@ static inline void alpha_composite_##depth##_##nbits##bits(const AVFrame *src, c
                                                                                                            \
     const uint8_t *sa = src->data[3] +     (slice_start) * src->linesize[3];                               \
     uint8_t       *da = dst->data[3] + (y + slice_start) * dst->linesize[3];                               \
+    const uint8_t *cov = octx->coverage_skip ? octx->coverage : NULL;                                      \
                                                                                                            \
     for (int i = slice_start; i < slice_end; ++i) {                                                        \
         const T *s = (const T *)sa + jmin;                                                                 \
         T *d = (T *)da + x + jmin;                                                                         \
+        const uint8_t *covi = cov ? cov + i * octx->coverage_tiles : NULL;                                 \
+                                                                                                           \
+        for (int j = jmin; j < jmax;) {                                                                    \
+            int jend = jmax;                                                                               \
                                                                                                            \
-        for (int j = jmin; j < jmax; ++j) {                                                                \
-            alpha = *s;                                                                                    \
-            if (main_straight && alpha != 0 && alpha != max) {                                             \
-                uint8_t alpha_d = *d;                                                                      \
-                alpha = UNPREMULTIPLY_ALPHA(alpha, alpha_d);                                               \
+            if (covi) {                                                                                    \
+                const int t = j / COVERAGE_TILE;                                                           \
+                                                                                                           \
+                jend = FFMIN(jmax, (t + 1) * COVERAGE_TILE);                                               \
+                if (covi[t] != COVERAGE_MIXED) {                                                           \
+                    if (covi[t] == COVERAGE_OPAQUE)                                                        \
+                        memcpy(d, s, (jend - j) * sizeof(T));                                              \
+                    d += jend - j;                                                                         \
+                    s += jend - j;                                                                         \
+                    j  = jend;                                                                             \
+                    continue;                                                                              \
+                }                                                                                          \
             }                                                                                              \
-            if (alpha == max)                                                                              \
-                *d = *s;                                                                                   \
-            else if (alpha > 0) {                                                                          \
-                /* apply alpha compositing: main_alpha += (1-main_alpha) * overlay_alpha */                \
-                if (nbits > 8)                                                                             \
-                    *d += (max - *d) * *s / max;                                                           \
-                else                                                                                       \
-                    *d += FAST_DIV255((max - *d) * *s);                                                    \
+                                                                                                           \
+            for (; j < jend; ++j) {                                                                        \
+                alpha = *s;                                                                                \
+                if (main_straight && alpha != 0 && alpha != max) {                                         \
+                    uint8_t alpha_d = *d;                                                                  \
+                    alpha = UNPREMULTIPLY_ALPHA(alpha, alpha_d);                                           \
+                }                                                                                          \
+                if (alpha == max)                                                                          \
+                    *d = *s;                                                                               \
+                else if (alpha > 0) {                                                                      \
+                    /* apply alpha compositing: main_alpha += (1-main_alpha) * overlay_alpha */            \
+                    if (nbits > 8)                                                                         \
+                        *d += (max - *d) * *s / max;                                                       \
+                    else                                                                                   \
+                        *d += FAST_DIV255((max - *d) * *s);                                                \
+                }                                                                                          \
+                d += 1;                                                                                    \
+                s += 1;                                                                                    \
             }                                                                                              \
-            d += 1;                                                                                        \
-            s += 1;                                                                                        \
         }                                                                                                  \
         da += dst->linesize[3];                                                                            \
         sa += src->linesize[3];                                                                            \
@@ -655,8 +727,8 @@ static av_always_inline void blend_slice_yuv_##depth##_##nbits##bits(AVFilterCon
                 s->main_desc->comp[2].step, overlay_straight, 1, jobnr, nb_jobs);                          \
                                                                                                            \
     if (s->main_has_alpha)                                                                                 \
-        alpha_composite_##depth##_##nbits##bits(src, dst, src_w, src_h, dst_w, dst_h, x, y, main_straight, \
-                                                jobnr, nb_jobs);                                           \
+        alpha_composite_##depth##_##nbits##bits(s, src, dst, src_w, src_h, dst_w, dst_h, x, y,             \
+                                                main_straight, jobnr, nb_jobs);                            \
 }
 DEFINE_BLEND_SLICE_YUV(8, 8)
 DEFINE_BLEND_SLICE_YUV(16, 10)
@@ -687,7 +759,7 @@ static av_always_inline void blend_slice_planar_rgb(AVFilterContext *ctx,
                 jobnr, nb_jobs);
 
     if (s->main_has_alpha)
-        alpha_composite_8_8bits(src, dst, src_w, src_h, dst_w, dst_h, x, y, main_straight, jobnr, nb_jobs);
+        alpha_composite_8_8bits(s, src, dst, src_w, src_h, dst_w, dst_h, x, y, main_straight, jobnr, nb_jobs);
 }
 
 #define DEFINE_BLEND_SLICE_PLANAR_FMT_(format_, blend_slice_fn_suffix_, hsub_, vsub_, main_straight_, overlay_straight_) \
@@ -842,6 +914,69 @@ static int init_slice_fn(AVFilterContext *ctx)
     return 0;
 }
 
+/**
+ * Classify each COVERAGE_TILE wide run of every overlay alpha line as fully
+ * transparent, fully opaque or mixed. The map is kept for as long as the
+ * overlay alpha plane is unchanged, which is the common case of a static
+ * logo repeated by framesync.
+ */
+static int update_coverage(AVFilterContext *ctx, const AVFrame *src)
+{
+    OverlayContext *s = ctx->priv;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(src->format);
+    AVBufferRef *buf = av_frame_get_plane_buffer(src, 3);
+    const int depth = desc->comp[3].depth;
+    const int max = (1 << depth) - 1;
+    const int tiles = (src->width + COVERAGE_TILE - 1) / COVERAGE_TILE;
+
+    if (s->coverage_buf && buf && s->coverage_buf->data == buf->data &&
+        s->coverage_data == src->data[3] && s->coverage_linesize == src->linesize[3] &&
+        s->coverage_w == src->width && s->coverage_h == src->height)
+        return 0;
+
+    av_buffer_unref(&s->coverage_buf);
+    s->coverage_skip = 0;
+    if (!buf)
+        return 0;
+
+    av_fast_malloc(&s->coverage, &s->coverage_size, (size_t)tiles * src->height);
+    if (!s->coverage)
+        return AVERROR(ENOMEM);
+
+    for (int y = 0; y < src->height; y++) {
+        const uint8_t *a = src->data[3] + y * src->linesize[3];
+        uint8_t *cov = s->coverage + y * tiles;
+
+        for (int t = 0; t < tiles; t++) {
+            const int x1 = FFMIN((t + 1) * COVERAGE_TILE, src->width);
+            int lo = max, hi = 0;
+
+            /* stop as soon as the tile is known to be mixed */
+            for (int x = t * COVERAGE_TILE; x < x1 && (lo == max || !hi); x++) {
+                const int v = depth > 8 ? ((const uint16_t *)a)[x] : a[x];
+                lo = FFMIN(lo, v);
+                hi = FFMAX(hi, v);
+            }
+            cov[t] = !hi                     ? COVERAGE_TRANSPARENT :
+                     lo == max && hi == max  ? COVERAGE_OPAQUE      :
+                                               COVERAGE_MIXED;
+            s->coverage_skip |= cov[t] != COVERAGE_MIXED;
+        }
+    }
+
+    s->coverage_buf = av_buffer_ref(buf);
+    if (!s->coverage_buf) {
+        s->coverage_skip = 0;
+        return AVERROR(ENOMEM);
+    }
+    s->coverage_tiles    = tiles;
+    s->coverage_data     = src->data[3];
+    s->coverage_linesize = src->linesize[3];
+    s->coverage_w        = src->width;
+    s->coverage_h        = src->height;
+    return 0;
+}
+
 static int do_blend(FFFrameSync *fs)
 {
     AVFilterContext *ctx = fs->parent;
@@ -881,6 +1016,11 @@ static int do_blend(FFFrameSync *fs)
 
         init_slice_fn(ctx);
 
+        if (!s->overlay_is_packed_rgb && (ret = update_coverage(ctx, second)) < 0) {
+            av_frame_free(&mainpic);
+            return ret;
+        }
+
         td.dst = mainpic;
         td.src = second;
         ff_filter_execute(ctx, s->blend_slice, &td, NULL, FFMIN(FFMAX(1, FFMIN3(s->y + second->height, FFMIN(second->height, mainpic->height), mainpic->height - s->y)),
@@ -77,6 +77,15 @@ typedef struct OverlayContext {
 
     AVExpr *x_pexpr, *y_pexpr;
 
+    uint8_t *coverage;          ///< per-tile class of the overlay alpha, one row per alpha line
+    unsigned int coverage_size;
+    int coverage_tiles;         ///< number of tiles per alpha line
+    int coverage_skip;          ///< set if any tile is fully transparent or opaque
+    AVBufferRef *coverage_buf;  ///< alpha buffer the coverage was computed from
+    const uint8_t *coverage_data;
+    ptrdiff_t coverage_linesize;
+    int coverage_w, coverage_h;
+
     int (*blend_row[4])(uint8_t *d, uint8_t *da, uint8_t *s, uint8_t *a, int w,
                         ptrdiff_t alinesize);
     int (*blend_slice)(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs);
@@ -66,7 +66,8 @@ AVFrame *ff_default_get_video_buffer2(AVFilterLink *link, int w, int h, int alig
         return frame;
     }
 
-    if (ff_frame_pool_video_reinit(&li->frame_pool, w, h, link->format, align) < 0)
+    if (ff_frame_pool_video_reinit(&li->frame_pool, ff_link_frame_pool_cache(li),
+                                   w, h, link->format, align) < 0)
         return NULL;
 
     frame = ff_frame_pool_get(&li->frame_pool);
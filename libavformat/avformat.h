@@ -1987,6 +1987,21 @@ typedef struct AVFormatContext {
      * - demuxing: Set by user
      */
     int recursion_limit;
+
+    /**
+     * Path of a file caching the stream parameters found by
+     * avformat_find_stream_info(). If the file matches the input, the
+     * parameters are restored from it and no packets are read, otherwise
+     * it is (re)written once the parameters have been found.
+     *
+     * The cache is only used with seekable inputs. It is matched against
+     * the input size and the stream parameters exported by the demuxer
+     * before probing.
+     *
+     * - demuxing: Set by user
+     * - muxing: Unused
+     */
+    char *stream_info_cache;
 } AVFormatContext;
 
 /**
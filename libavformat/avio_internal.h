@@ -73,6 +73,17 @@ typedef struct FFIOContext {
      */
     int orig_buffer_size;
 
+    /**
+     * Size of the reads done while the input is consumed sequentially,
+     * 0 until the buffer has been refilled without seeking in between
+     */
+    int read_ahead;
+
+    /**
+     * Value of seek_count when read_ahead was last updated
+     */
+    int read_ahead_seek_count;
+
     /**
      * Written output size
      * is updated each time a successful writeout ends up further position-wise
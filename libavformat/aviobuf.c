@@ -42,6 +42,12 @@
  */
 #define SHORT_SEEK_THRESHOLD 32768
 
+/**
+ * Largest size the read buffer is grown to while the input is read
+ * sequentially, see fill_buffer().
+ */
+#define READ_AHEAD_MAX (IO_BUFFER_SIZE * 16)
+
 static void fill_buffer(AVIOContext *s);
 static int url_resetbuf(AVIOContext *s, int flags);
 /** @warning must be called before any I/O */
@@ -519,6 +525,8 @@ static void fill_buffer(AVIOContext *s)
     uint8_t *dst        = s->buf_end - s->buffer + max_buffer_size <= s->buffer_size ?
                           s->buf_end : s->buffer;
     int len             = s->buffer_size - (dst - s->buffer);
+    uint8_t *new_buffer = NULL;
+    int target_size;
 
     /* can't fill the buffer without read_packet, just set EOF if appropriate */
     if (!s->read_packet && s->buf_ptr >= s->buf_end)
@@ -535,20 +543,52 @@ static void fill_buffer(AVIOContext *s)
         s->checksum_ptr = s->buffer;
     }
 
+    /* Read in larger chunks while the input is consumed sequentially, this
+     * saves protocol calls when demuxing large files. Any real seek goes
+     * back to the original buffer size. */
+    if (ctx->seek_count != ctx->read_ahead_seek_count) {
+        ctx->read_ahead_seek_count = ctx->seek_count;
+        ctx->read_ahead = 0;
+    } else if (dst == s->buffer && s->read_packet && ctx->orig_buffer_size &&
+               !s->max_packet_size && !s->direct) {
+        ctx->read_ahead = FFMIN(FFMAX(ctx->read_ahead, ctx->orig_buffer_size) * 2,
+                                FFMAX(READ_AHEAD_MAX, ctx->orig_buffer_size));
+        /* the buffer contents are about to be discarded, so read into a
+         * larger one which replaces it if the read succeeds */
+        if (s->buffer_size < ctx->read_ahead &&
+            (new_buffer = av_malloc(ctx->read_ahead))) {
+            dst = new_buffer;
+            len = ctx->read_ahead;
+        }
+    }
+    target_size = FFMAX(ctx->orig_buffer_size, ctx->read_ahead);
+
     /* make buffer smaller in case it ended up large after probing */
-    if (s->read_packet && ctx->orig_buffer_size &&
-        s->buffer_size > ctx->orig_buffer_size  && len >= ctx->orig_buffer_size) {
+    if (s->read_packet && ctx->orig_buffer_size && !new_buffer &&
+        s->buffer_size > target_size && len >= target_size) {
         if (dst == s->buffer && s->buf_ptr != dst) {
-            int ret = set_buf_size(s, ctx->orig_buffer_size);
+            int orig_buffer_size = ctx->orig_buffer_size;
+            int ret = set_buf_size(s, target_size);
             if (ret < 0)
                 av_log(s, AV_LOG_WARNING, "Failed to decrease buffer size\n");
 
+            ctx->orig_buffer_size = orig_buffer_size;
             s->checksum_ptr = dst = s->buffer;
         }
-        len = ctx->orig_buffer_size;
+        len = target_size;
     }
 
     len = read_packet_wrapper(s, dst, len);
+    if (new_buffer) {
+        if (len > 0) {
+            av_free(s->buffer);
+            s->checksum_ptr = s->buf_ptr_max = s->buffer = new_buffer;
+            s->buffer_size = ctx->read_ahead;
+        } else {
+            av_free(new_buffer);
+            dst = s->buffer;
+        }
+    }
     if (len == AVERROR_EOF) {
         /* do not modify buffer if EOF reached so that a seek back can
            be done without rereading data */
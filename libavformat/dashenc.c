@@ -51,6 +51,7 @@
 #include "internal.h"
 #include "mux.h"
 #include "os_support.h"
+#include "segwriter.h"
 #include "url.h"
 #include "dash.h"
 
@@ -204,6 +205,9 @@ typedef struct DASHContext {
     int64_t update_period;
     int64_t availability_start_time_ms;
     int64_t suggested_presentation_delay;
+    int write_threads;
+    int max_pending_writes;
+    SegmentWriter *writer; ///< writes segments and manifests in the background
 } DASHContext;
 
 static int dashenc_io_open(AVFormatContext *s, AVIOContext **pb, char *filename,
@@ -244,6 +248,27 @@ static void dashenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filenam
     }
 }
 
+/* Media segments and manifests are written in one go, by the background
+ * writer if enabled. */
+static int dashenc_file_open(AVFormatContext *s, AVIOContext **pb, char *filename,
+                             AVDictionary **options)
+{
+    DASHContext *c = s->priv_data;
+    if (c->writer)
+        return ff_segment_writer_open(c->writer, pb, filename, options);
+    return dashenc_io_open(s, pb, filename, options);
+}
+
+static int dashenc_file_close(AVFormatContext *s, AVIOContext **pb, char *filename,
+                              int flags)
+{
+    DASHContext *c = s->priv_data;
+    if (c->writer)
+        return ff_segment_writer_close(c->writer, pb, flags);
+    dashenc_io_close(s, pb, filename);
+    return 0;
+}
+
 static const char *get_format_str(SegmentType segment_type)
 {
     switch (segment_type) {
@@ -402,7 +427,7 @@ static void write_hls_media_playlist(OutputStream *os, AVFormatContext *s,
     snprintf(temp_filename_hls, sizeof(temp_filename_hls), use_rename ? "%s.tmp" : "%s", filename_hls);
 
     set_http_options(&http_opts, c);
-    ret = dashenc_io_open(s, &c->m3u8_out, temp_filename_hls, &http_opts);
+    ret = dashenc_file_open(s, &c->m3u8_out, temp_filename_hls, &http_opts);
     av_dict_free(&http_opts);
     if (ret < 0) {
         handle_io_open_error(s, ret, temp_filename_hls);
@@ -448,10 +473,10 @@ static void write_hls_media_playlist(OutputStream *os, AVFormatContext *s,
     if (final)
         ff_hls_write_end_list(c->m3u8_out);
 
-    dashenc_io_close(s, &c->m3u8_out, temp_filename_hls);
+    dashenc_file_close(s, &c->m3u8_out, temp_filename_hls, FF_SEGMENT_WRITE_ORDERED);
 
     if (use_rename)
-        ff_rename(temp_filename_hls, filename_hls, os->ctx);
+        ff_segment_writer_rename(c->writer, temp_filename_hls, filename_hls, os->ctx);
 }
 
 static int flush_init_segment(AVFormatContext *s, OutputStream *os)
@@ -486,6 +511,13 @@ static void dash_free(AVFormatContext *s)
         c->nb_as = 0;
     }
 
+    ff_segment_writer_discard(c->writer, &c->mpd_out);
+    ff_segment_writer_discard(c->writer, &c->m3u8_out);
+    if (c->streams)
+        for (i = 0; i < s->nb_streams; i++)
+            ff_segment_writer_discard(c->writer, &c->streams[i].out);
+    ff_segment_writer_free(&c->writer);
+
     if (!c->streams)
         return;
     for (i = 0; i < s->nb_streams; i++) {
@@ -1020,7 +1052,7 @@ static int write_manifest(AVFormatContext *s, int final)
 
     snprintf(temp_filename, sizeof(temp_filename), use_rename ? "%s.tmp" : "%s", s->url);
     set_http_options(&opts, c);
-    ret = dashenc_io_open(s, &c->mpd_out, temp_filename, &opts);
+    ret = dashenc_file_open(s, &c->mpd_out, temp_filename, &opts);
     av_dict_free(&opts);
     if (ret < 0) {
         return handle_io_open_error(s, ret, temp_filename);
@@ -1118,10 +1150,12 @@ static int write_manifest(AVFormatContext *s, int final)
 
     avio_printf(out, "</MPD>\n");
     avio_flush(out);
-    dashenc_io_close(s, &c->mpd_out, temp_filename);
+    ret = dashenc_file_close(s, &c->mpd_out, temp_filename, FF_SEGMENT_WRITE_ORDERED);
+    if (ret < 0 && !c->ignore_io_errors)
+        return ret;
 
     if (use_rename) {
-        if ((ret = ff_rename(temp_filename, s->url, s)) < 0)
+        if ((ret = ff_segment_writer_rename(c->writer, temp_filename, s->url, s)) < 0)
             return ret;
     }
 
@@ -1141,7 +1175,7 @@ static int write_manifest(AVFormatContext *s, int final)
         snprintf(temp_filename, sizeof(temp_filename), use_rename ? "%s.tmp" : "%s", filename_hls);
 
         set_http_options(&opts, c);
-        ret = dashenc_io_open(s, &c->m3u8_out, temp_filename, &opts);
+        ret = dashenc_file_open(s, &c->m3u8_out, temp_filename, &opts);
         av_dict_free(&opts);
         if (ret < 0) {
             return handle_io_open_error(s, ret, temp_filename);
@@ -1235,9 +1269,9 @@ static int write_manifest(AVFormatContext *s, int final)
             }
         }
 
-        dashenc_io_close(s, &c->m3u8_out, temp_filename);
+        dashenc_file_close(s, &c->m3u8_out, temp_filename, FF_SEGMENT_WRITE_ORDERED);
         if (use_rename)
-            if ((ret = ff_rename(temp_filename, filename_hls, s)) < 0)
+            if ((ret = ff_segment_writer_rename(c->writer, temp_filename, filename_hls, s)) < 0)
                 return ret;
         c->master_playlist_created = 1;
     }
@@ -1608,6 +1642,21 @@ static int dash_init(AVFormatContext *s)
     c->nr_of_streams_flushed = 0;
     c->target_latency_refid = -1;
 
+    if (c->write_threads) {
+        if (c->single_file || c->streaming) {
+            av_log(s, AV_LOG_WARNING, "write_threads is not supported with single_file "
+                   "or streaming, writing on the muxing thread\n");
+        } else {
+            ret = ff_segment_writer_alloc(&c->writer, s, c->write_threads,
+                                          c->max_pending_writes);
+            if (ret == AVERROR(ENOSYS))
+                av_log(s, AV_LOG_WARNING, "write_threads needs thread support, "
+                       "writing on the muxing thread\n");
+            else if (ret < 0)
+                return ret;
+        }
+    }
+
     return 0;
 }
 
@@ -1735,6 +1784,8 @@ static void dashenc_delete_file(AVFormatContext *s, char *filename) {
     DASHContext *c = s->priv_data;
     int http_base_proto = ff_is_http_proto(filename);
 
+    ff_segment_writer_wait(c->writer, filename);
+
     if (http_base_proto) {
         AVDictionary *http_opts = NULL;
 
@@ -1849,10 +1900,12 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
         if (c->single_file) {
             find_index_range(s, os->full_path, os->pos, &index_length);
         } else {
-            dashenc_io_close(s, &os->out, os->temp_path);
+            ret = dashenc_file_close(s, &os->out, os->temp_path, 0);
+            if (ret < 0 && !c->ignore_io_errors)
+                break;
 
             if (use_rename) {
-                ret = ff_rename(os->temp_path, os->full_path, os->ctx);
+                ret = ff_segment_writer_rename(c->writer, os->temp_path, os->full_path, os->ctx);
                 if (ret < 0)
                     break;
             }
@@ -2144,7 +2197,7 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
         snprintf(os->temp_path, sizeof(os->temp_path),
                  use_rename ? "%s.tmp" : "%s", os->full_path);
         set_http_options(&opts, c);
-        ret = dashenc_io_open(s, &os->out, os->temp_path, &opts);
+        ret = dashenc_file_open(s, &os->out, os->temp_path, &opts);
         av_dict_free(&opts);
         if (ret < 0) {
             return handle_io_open_error(s, ret, os->temp_path);
@@ -2197,6 +2250,8 @@ static int dash_write_trailer(AVFormatContext *s)
                                          AV_TIME_BASE_Q);
     }
     dash_flush(s, 1, -1);
+    // write errors are logged by the writer and not fatal, as for dashenc_io_close()
+    ff_segment_writer_flush(c->writer);
 
     if (c->remove_at_exit) {
         for (i = 0; i < s->nb_streams; ++i) {
@@ -2270,6 +2325,7 @@ static const AVOption options[] = {
     { "ldash", "Enable Low-latency dash. Constrains the value of a few elements", OFFSET(ldash), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     { "lhls", "Enable Low-latency HLS(Experimental). Adds #EXT-X-PREFETCH tag with current segment's URI", OFFSET(lhls), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     { "master_m3u8_publish_rate", "Publish master playlist every after this many segment intervals", OFFSET(master_publish_rate), AV_OPT_TYPE_INT, {.i64 = 0}, 0, UINT_MAX, E},
+    { "max_pending_writes", "maximum number of segments and manifests waiting to be written", OFFSET(max_pending_writes), AV_OPT_TYPE_INT, { .i64 = 4 }, 1, INT_MAX, E },
     { "max_playback_rate", "Set desired maximum playback rate", OFFSET(max_playback_rate), AV_OPT_TYPE_RATIONAL, { .dbl = 1.0 }, 0.5, 1.5, E },
     { "media_seg_name", "DASH-templated name to used for the media segments", OFFSET(media_seg_name), AV_OPT_TYPE_STRING, {.str = "chunk-stream$RepresentationID$-$Number%05d$.$ext$"}, 0, 0, E },
     { "method", "set the HTTP method", OFFSET(method), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, E },
@@ -2292,6 +2348,7 @@ static const AVOption options[] = {
     { "utc_timing_url", "URL of the page that will return the UTC timestamp in ISO format", OFFSET(utc_timing_url), AV_OPT_TYPE_STRING, { 0 }, 0, 0, E },
     { "window_size", "number of segments kept in the manifest", OFFSET(window_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, E },
     { "write_prft", "Write producer reference time element", OFFSET(write_prft), AV_OPT_TYPE_BOOL, {.i64 = -1}, -1, 1, E},
+    { "write_threads", "number of threads writing segments and manifests in the background", OFFSET(write_threads), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 64, E },
     { NULL },
 };
 
@@ -25,6 +25,8 @@
 
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
+#include "libavutil/channel_layout.h"
+#include "libavutil/crc.h"
 #include "libavutil/dict.h"
 #include "libavutil/internal.h"
 #include "libavutil/intreadwrite.h"
@@ -37,6 +39,7 @@
 
 #include "libavcodec/avcodec.h"
 #include "libavcodec/bsf.h"
+#include "libavcodec/bytestream.h"
 #include "libavcodec/codec_desc.h"
 #include "libavcodec/internal.h"
 #include "packet_internal.h"
@@ -2603,6 +2606,348 @@ fail:
     return ret;
 }
 
+#define STREAM_INFO_CACHE_TAG     MKBETAG('L','S','I','C')
+#define STREAM_INFO_CACHE_VERSION 1
+#define STREAM_INFO_CACHE_HASH_SIZE (64 * 1024)
+
+/**
+ * Compute the key identifying the input a stream info cache was built from:
+ * the CRC of the demuxer name, of the start of the input and of the stream
+ * parameters known before probing. The file size is checked separately.
+ */
+static int stream_info_cache_key(AVFormatContext *ic, uint32_t *key)
+{
+    const AVCRC *table = av_crc_get_table(AV_CRC_32_IEEE_LE);
+    uint32_t crc = av_crc(table, UINT32_MAX, ic->iformat->name,
+                          strlen(ic->iformat->name));
+    int64_t pos = avio_tell(ic->pb);
+    uint8_t *data;
+    int64_t ret;
+    int len;
+
+    if (!(data = av_malloc(STREAM_INFO_CACHE_HASH_SIZE)))
+        return AVERROR(ENOMEM);
+    if ((ret = avio_seek(ic->pb, 0, SEEK_SET)) < 0) {
+        av_free(data);
+        return ret;
+    }
+    len = avio_read(ic->pb, data, STREAM_INFO_CACHE_HASH_SIZE);
+    if (len > 0)
+        crc = av_crc(table, crc, data, len);
+    av_free(data);
+    if ((ret = avio_seek(ic->pb, pos, SEEK_SET)) < 0)
+        return ret;
+
+    for (unsigned i = 0; i < ic->nb_streams; i++) {
+        const AVStream *st = ic->streams[i];
+        const AVCodecParameters *par = st->codecpar;
+        uint8_t buf[28], *p = buf;
+
+        bytestream_put_be32(&p, par->codec_type);
+        bytestream_put_be32(&p, par->codec_id);
+        bytestream_put_be32(&p, par->codec_tag);
+        bytestream_put_be32(&p, st->id);
+        bytestream_put_be32(&p, st->time_base.num);
+        bytestream_put_be32(&p, st->time_base.den);
+        bytestream_put_be32(&p, par->extradata_size);
+        crc = av_crc(table, crc, buf, p - buf);
+        if (par->extradata_size)
+            crc = av_crc(table, crc, par->extradata, par->extradata_size);
+    }
+    *key = crc;
+    return 0;
+}
+
+static int write_stream_info_codecpar(AVIOContext *pb, const AVCodecParameters *par)
+{
+    if (par->ch_layout.order == AV_CHANNEL_ORDER_CUSTOM)
+        return AVERROR(ENOSYS);
+
+    avio_wb32(pb, par->codec_type);
+    avio_wb32(pb, par->codec_id);
+    avio_wb32(pb, par->codec_tag);
+    avio_wb32(pb, par->format);
+    avio_wb64(pb, par->bit_rate);
+    avio_wb32(pb, par->bits_per_coded_sample);
+    avio_wb32(pb, par->bits_per_raw_sample);
+    avio_wb32(pb, par->profile);
+    avio_wb32(pb, par->level);
+    avio_wb32(pb, par->width);
+    avio_wb32(pb, par->height);
+    avio_wb32(pb, par->sample_aspect_ratio.num);
+    avio_wb32(pb, par->sample_aspect_ratio.den);
+    avio_wb32(pb, par->framerate.num);
+    avio_wb32(pb, par->framerate.den);
+    avio_wb32(pb, par->field_order);
+    avio_wb32(pb, par->color_range);
+    avio_wb32(pb, par->color_primaries);
+    avio_wb32(pb, par->color_trc);
+    avio_wb32(pb, par->color_space);
+    avio_wb32(pb, par->chroma_location);
+    avio_wb32(pb, par->video_delay);
+    avio_wb32(pb, par->ch_layout.order);
+    avio_wb32(pb, par->ch_layout.nb_channels);
+    avio_wb64(pb, par->ch_layout.order == AV_CHANNEL_ORDER_UNSPEC ? 0 : par->ch_layout.u.mask);
+    avio_wb32(pb, par->sample_rate);
+    avio_wb32(pb, par->block_align);
+    avio_wb32(pb, par->frame_size);
+    avio_wb32(pb, par->initial_padding);
+    avio_wb32(pb, par->trailing_padding);
+    avio_wb32(pb, par->seek_preroll);
+
+    avio_wb32(pb, par->extradata_size);
+    avio_write(pb, par->extradata, par->extradata_size);
+    avio_wb32(pb, par->nb_coded_side_data);
+    for (int i = 0; i < par->nb_coded_side_data; i++) {
+        const AVPacketSideData *sd = &par->coded_side_data[i];
+        if (sd->size > INT_MAX)
+            return AVERROR(ENOSYS);
+        avio_wb32(pb, sd->type);
+        avio_wb32(pb, sd->size);
+        avio_write(pb, sd->data, sd->size);
+    }
+    return 0;
+}
+
+static void write_stream_info_cache(AVFormatContext *ic, uint32_t key)
+{
+    int64_t file_size = avio_size(ic->pb);
+    AVIOContext *pb = NULL;
+    char *tmp;
+    int ret;
+
+    if (file_size <= 0)
+        return;
+
+    tmp = av_asprintf("%s.tmp", ic->stream_info_cache);
+    if (!tmp)
+        return;
+
+    if ((ret = ic->io_open(ic, &pb, tmp, AVIO_FLAG_WRITE, NULL)) < 0)
+        goto end;
+
+    avio_wb32(pb, STREAM_INFO_CACHE_TAG);
+    avio_wb32(pb, STREAM_INFO_CACHE_VERSION);
+    avio_wb64(pb, file_size);
+    avio_wb32(pb, key);
+    avio_wb64(pb, ic->start_time);
+    avio_wb64(pb, ic->duration);
+    avio_wb64(pb, ic->bit_rate);
+    avio_wb32(pb, ic->duration_estimation_method);
+
+    avio_wb32(pb, ic->nb_streams);
+    for (unsigned i = 0; i < ic->nb_streams && ret >= 0; i++) {
+        const AVStream *st = ic->streams[i];
+
+        avio_wb64(pb, st->start_time);
+        avio_wb64(pb, st->duration);
+        avio_wb64(pb, st->nb_frames);
+        avio_wb32(pb, st->disposition);
+        avio_wb32(pb, st->sample_aspect_ratio.num);
+        avio_wb32(pb, st->sample_aspect_ratio.den);
+        avio_wb32(pb, st->avg_frame_rate.num);
+        avio_wb32(pb, st->avg_frame_rate.den);
+        avio_wb32(pb, st->r_frame_rate.num);
+        avio_wb32(pb, st->r_frame_rate.den);
+        avio_wb32(pb, cffstream(st)->codec_info_nb_frames);
+        ret = write_stream_info_codecpar(pb, st->codecpar);
+    }
+
+    avio_flush(pb);
+    if (ret >= 0)
+        ret = pb->error;
+    ff_format_io_close(ic, &pb);
+    if (ret >= 0)
+        ret = ff_rename(tmp, ic->stream_info_cache, ic);
+
+end:
+    if (ret < 0)
+        av_log(ic, AV_LOG_WARNING, "Could not write stream info cache %s\n",
+               ic->stream_info_cache);
+    av_free(tmp);
+}
+
+static int read_stream_info_codecpar(AVIOContext *pb, AVCodecParameters *par)
+{
+    uint32_t size, nb_side_data;
+
+    par->codec_type             = (int32_t)avio_rb32(pb);
+    par->codec_id               = avio_rb32(pb);
+    par->codec_tag              = avio_rb32(pb);
+    par->format                 = (int32_t)avio_rb32(pb);
+    par->bit_rate               = avio_rb64(pb);
+    par->bits_per_coded_sample  = avio_rb32(pb);
+    par->bits_per_raw_sample    = avio_rb32(pb);
+    par->profile                = (int32_t)avio_rb32(pb);
+    par->level                  = (int32_t)avio_rb32(pb);
+    par->width                  = avio_rb32(pb);
+    par->height                 = avio_rb32(pb);
+    par->sample_aspect_ratio.num = avio_rb32(pb);
+    par->sample_aspect_ratio.den = avio_rb32(pb);
+    par->framerate.num          = avio_rb32(pb);
+    par->framerate.den          = avio_rb32(pb);
+    par->field_order            = avio_rb32(pb);
+    par->color_range            = avio_rb32(pb);
+    par->color_primaries        = avio_rb32(pb);
+    par->color_trc              = avio_rb32(pb);
+    par->color_space            = avio_rb32(pb);
+    par->chroma_location        = avio_rb32(pb);
+    par->video_delay            = avio_rb32(pb);
+    par->ch_layout.order        = avio_rb32(pb);
+    par->ch_layout.nb_channels  = avio_rb32(pb);
+    par->ch_layout.u.mask       = avio_rb64(pb);
+    par->sample_rate            = avio_rb32(pb);
+    par->block_align            = avio_rb32(pb);
+    par->frame_size             = avio_rb32(pb);
+    par->initial_padding        = avio_rb32(pb);
+    par->trailing_padding       = avio_rb32(pb);
+    par->seek_preroll           = avio_rb32(pb);
+
+    if (par->ch_layout.order == AV_CHANNEL_ORDER_UNSPEC)
+        par->ch_layout.u.mask = 0;
+    if ((par->ch_layout.nb_channels || par->ch_layout.order) &&
+        (par->ch_layout.order == AV_CHANNEL_ORDER_CUSTOM ||
+         !av_channel_layout_check(&par->ch_layout)))
+        return AVERROR_INVALIDDATA;
+
+    size = avio_rb32(pb);
+    if (size) {
+        if (size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+            return AVERROR_INVALIDDATA;
+        if (ff_get_extradata(NULL, par, pb, size) < 0)
+            return AVERROR_INVALIDDATA;
+    }
+
+    nb_side_data = avio_rb32(pb);
+    for (uint32_t i = 0; i < nb_side_data; i++) {
+        enum AVPacketSideDataType type = avio_rb32(pb);
+        uint8_t *data;
+
+        size = avio_rb32(pb);
+        if (avio_feof(pb) || type >= AV_PKT_DATA_NB || size > INT_MAX)
+            return AVERROR_INVALIDDATA;
+        if (!(data = av_malloc(size)))
+            return AVERROR(ENOMEM);
+        if (ffio_read_size(pb, data, size) < 0 ||
+            !av_packet_side_data_add(&par->coded_side_data, &par->nb_coded_side_data,
+                                     type, data, size, 0)) {
+            av_free(data);
+            return AVERROR_INVALIDDATA;
+        }
+    }
+
+    return avio_feof(pb) ? AVERROR_INVALIDDATA : 0;
+}
+
+typedef struct StreamInfoCacheEntry {
+    int64_t start_time;
+    int64_t duration;
+    int64_t nb_frames;
+    int disposition;
+    AVRational sample_aspect_ratio;
+    AVRational avg_frame_rate;
+    AVRational r_frame_rate;
+    int codec_info_nb_frames;
+    AVCodecParameters *par;
+} StreamInfoCacheEntry;
+
+/**
+ * Restore the stream parameters from the stream info cache.
+ * @return 1 if they were restored, 0 if the cache does not match the input,
+ *         <0 on error
+ */
+static int read_stream_info_cache(AVFormatContext *ic, uint32_t key)
+{
+    int64_t file_size = avio_size(ic->pb);
+    StreamInfoCacheEntry *entries = NULL;
+    AVIOContext *pb = NULL;
+    int64_t start_time, duration, bit_rate;
+    int duration_estimation_method;
+    int ret = 0;
+
+    if (file_size <= 0 ||
+        ic->io_open(ic, &pb, ic->stream_info_cache, AVIO_FLAG_READ, NULL) < 0)
+        return 0;
+
+    if (avio_rb32(pb) != STREAM_INFO_CACHE_TAG ||
+        avio_rb32(pb) != STREAM_INFO_CACHE_VERSION ||
+        avio_rb64(pb) != file_size ||
+        avio_rb32(pb) != key)
+        goto end;
+
+    start_time                 = avio_rb64(pb);
+    duration                   = avio_rb64(pb);
+    bit_rate                   = avio_rb64(pb);
+    duration_estimation_method = avio_rb32(pb);
+
+    if (avio_rb32(pb) != ic->nb_streams)
+        goto end;
+
+    entries = av_calloc(ic->nb_streams, sizeof(*entries));
+    if (!entries) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for (unsigned i = 0; i < ic->nb_streams; i++) {
+        StreamInfoCacheEntry *e = &entries[i];
+
+        e->start_time               = avio_rb64(pb);
+        e->duration                 = avio_rb64(pb);
+        e->nb_frames                = avio_rb64(pb);
+        e->disposition              = avio_rb32(pb);
+        e->sample_aspect_ratio.num  = avio_rb32(pb);
+        e->sample_aspect_ratio.den  = avio_rb32(pb);
+        e->avg_frame_rate.num       = avio_rb32(pb);
+        e->avg_frame_rate.den       = avio_rb32(pb);
+        e->r_frame_rate.num         = avio_rb32(pb);
+        e->r_frame_rate.den         = avio_rb32(pb);
+        e->codec_info_nb_frames     = avio_rb32(pb);
+
+        if (!(e->par = avcodec_parameters_alloc())) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        if (read_stream_info_codecpar(pb, e->par) < 0 ||
+            e->par->codec_type != ic->streams[i]->codecpar->codec_type)
+            goto end;
+    }
+
+    for (unsigned i = 0; i < ic->nb_streams; i++) {
+        const StreamInfoCacheEntry *e = &entries[i];
+        AVStream *const st  = ic->streams[i];
+        FFStream *const sti = ffstream(st);
+
+        if ((ret = avcodec_parameters_copy(st->codecpar, e->par)) < 0)
+            goto end;
+        st->start_time           = e->start_time;
+        st->duration             = e->duration;
+        st->nb_frames            = e->nb_frames;
+        st->disposition          = e->disposition;
+        st->sample_aspect_ratio  = e->sample_aspect_ratio;
+        st->avg_frame_rate       = e->avg_frame_rate;
+        st->r_frame_rate         = e->r_frame_rate;
+        sti->codec_info_nb_frames = e->codec_info_nb_frames;
+        sti->codec_desc          = avcodec_descriptor_get(st->codecpar->codec_id);
+        sti->need_context_update = 1;
+    }
+    ic->start_time                 = start_time;
+    ic->duration                   = duration;
+    ic->bit_rate                   = bit_rate;
+    ic->duration_estimation_method = duration_estimation_method;
+    ret = 1;
+
+end:
+    if (!ret)
+        av_log(ic, AV_LOG_VERBOSE, "Stream info cache %s does not match the input\n",
+               ic->stream_info_cache);
+    if (entries)
+        for (unsigned i = 0; i < ic->nb_streams; i++)
+            avcodec_parameters_free(&entries[i].par);
+    av_free(entries);
+    ff_format_io_close(ic, &pb);
+    return ret;
+}
+
 int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
 {
     FFFormatContext *const si = ffformatcontext(ic);
@@ -2618,9 +2963,26 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
     int64_t max_subtitle_analyze_duration;
     int64_t probesize = ic->probesize;
     int eof_reached = 0;
+    int use_cache = ic->stream_info_cache && ic->pb &&
+                    (ic->pb->seekable & AVIO_SEEKABLE_NORMAL);
+    int all_found = 1;
+    uint32_t cache_key = 0;
 
     flush_codecs = probesize > 0;
 
+    if (use_cache) {
+        if ((ret = stream_info_cache_key(ic, &cache_key)) < 0)
+            return ret;
+        ret = read_stream_info_cache(ic, cache_key);
+        if (ret < 0)
+            return ret;
+        if (ret > 0) {
+            av_log(ic, AV_LOG_DEBUG, "Stream parameters restored from %s\n",
+                   ic->stream_info_cache);
+            return compute_chapters_end(ic);
+        }
+    }
+
     av_opt_set_int(ic, "skip_clear", 1, AV_OPT_SEARCH_CHILDREN);
 
     max_stream_analyze_duration = max_analyze_duration;
@@ -3118,6 +3480,7 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
                    "Could not find codec parameters for stream %d (%s): %s\n"
                    "Consider increasing the value for the 'analyzeduration' (%"PRId64") and 'probesize' (%"PRId64") options\n",
                    i, buf, errmsg, ic->max_analyze_duration, ic->probesize);
+            all_found = 0;
         } else {
             ret = 0;
         }
@@ -3181,6 +3544,10 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         lcevc->height = st->codecpar->height;
     }
 
+    /* streams found while probing cannot be recreated from the cache */
+    if (use_cache && ret >= 0 && all_found && ic->nb_streams == orig_nb_streams)
+        write_stream_info_cache(ic, cache_key);
+
 find_stream_info_err:
     for (unsigned i = 0; i < ic->nb_streams; i++) {
         AVStream *const st  = ic->streams[i];
@@ -90,6 +90,10 @@
 #  endif
 #endif
 
+/* pages read with the nocache option are dropped from the cache in chunks
+ * of this size */
+#define NOCACHE_CHUNK (1 << 20)
+
 /* standard file protocol */
 
 typedef struct FileContext {
@@ -100,6 +104,11 @@ typedef struct FileContext {
     int pkt_size;
     int follow;
     int seekable;
+    int readahead;
+    int nocache;
+    int64_t pos;            ///< current file position, for the read hints
+    int64_t readahead_end;  ///< end of the range already announced to the kernel
+    int64_t nocache_pos;    ///< start of the read range not dropped from the cache yet
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
@@ -111,6 +120,8 @@ static const AVOption file_options[] = {
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
     { "pkt_size", "Maximum packet size", offsetof(FileContext, pkt_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "readahead", "Amount of data the system should read ahead of the current position", offsetof(FileContext, readahead), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, AV_OPT_FLAG_DECODING_PARAM },
+    { "nocache", "Drop data from the system cache once it has been read", offsetof(FileContext, nocache), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -141,12 +152,31 @@ static const AVClass fd_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+static void file_advise_read(FileContext *c, int size)
+{
+#if HAVE_POSIX_FADVISE
+    c->pos += size;
+
+    if (c->readahead && c->pos + c->readahead / 2 > c->readahead_end) {
+        int64_t start = FFMAX(c->readahead_end, c->pos);
+        posix_fadvise(c->fd, start, c->pos + c->readahead - start, POSIX_FADV_WILLNEED);
+        c->readahead_end = c->pos + c->readahead;
+    }
+    if (c->nocache && c->pos - c->nocache_pos >= NOCACHE_CHUNK) {
+        posix_fadvise(c->fd, c->nocache_pos, c->pos - c->nocache_pos, POSIX_FADV_DONTNEED);
+        c->nocache_pos = c->pos;
+    }
+#endif
+}
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
     ret = read(c->fd, buf, size);
+    if (ret > 0)
+        file_advise_read(c, ret);
     if (ret == 0 && c->follow)
         return AVERROR(EAGAIN);
     if (ret == 0)
@@ -246,6 +276,8 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
     }
 
     ret = lseek(c->fd, pos, whence);
+    if (ret >= 0)
+        c->pos = c->readahead_end = c->nocache_pos = ret;
 
     return ret < 0 ? AVERROR(errno) : ret;
 }
@@ -334,6 +366,14 @@ static int file_open(URLContext *h, const char *filename, int flags)
     if (c->seekable >= 0)
         h->is_streamed = !c->seekable;
 
+#if HAVE_POSIX_FADVISE
+    if (c->readahead && !(flags & AVIO_FLAG_WRITE))
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#else
+    if (c->readahead || c->nocache)
+        av_log(h, AV_LOG_WARNING, "readahead and nocache are not supported on this system\n");
+#endif
+
     return 0;
 }
 
@@ -54,6 +54,7 @@
 #include "internal.h"
 #include "mux.h"
 #include "os_support.h"
+#include "segwriter.h"
 #include "url.h"
 
 typedef enum {
@@ -262,6 +263,9 @@ typedef struct HLSContext {
     char *headers;
     int has_default_key; /* has DEFAULT field of var_stream_map */
     int has_video_m3u8; /* has video stream m3u8 list */
+    int write_threads;
+    int max_pending_writes;
+    SegmentWriter *writer; /* writes segments and playlists in the background */
 } HLSContext;
 
 static int strftime_expand(const char *fmt, char **dest)
@@ -328,6 +332,25 @@ static int hlsenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filename)
     return ret;
 }
 
+/* Segments and playlists are written in one go, by the background writer if enabled. */
+static int hlsenc_file_open(AVFormatContext *s, AVIOContext **pb, char *filename,
+                            AVDictionary **options)
+{
+    HLSContext *hls = s->priv_data;
+    if (hls->writer)
+        return ff_segment_writer_open(hls->writer, pb, filename, options);
+    return hlsenc_io_open(s, pb, filename, options);
+}
+
+static int hlsenc_file_close(AVFormatContext *s, AVIOContext **pb, char *filename,
+                             int flags)
+{
+    HLSContext *hls = s->priv_data;
+    if (hls->writer)
+        return ff_segment_writer_close(hls->writer, pb, flags);
+    return hlsenc_io_close(s, pb, filename);
+}
+
 static void set_http_options(AVFormatContext *s, AVDictionary **options, HLSContext *c)
 {
     int http_base_proto = ff_is_http_proto(s->url);
@@ -505,6 +528,8 @@ static void reflush_dynbuf(VariantStream *vs, int *range_length)
 static int hls_delete_file(HLSContext *hls, AVFormatContext *avf,
                            char *path, const char *proto)
 {
+    ff_segment_writer_wait(hls->writer, path);
+
     if (hls->method || (proto && !av_strcasecmp(proto, "http"))) {
         AVDictionary *opt = NULL;
         int ret;
@@ -991,7 +1016,7 @@ static int sls_flag_check_duration_size(HLSContext *hls, VariantStream *vs)
 static void sls_flag_file_rename(HLSContext *hls, VariantStream *vs, char *old_filename) {
     if ((hls->flags & (HLS_SECOND_LEVEL_SEGMENT_SIZE | HLS_SECOND_LEVEL_SEGMENT_DURATION)) &&
         strlen(vs->current_segment_final_filename_fmt)) {
-        ff_rename(old_filename, vs->avf->url, hls);
+        ff_segment_writer_rename(hls->writer, old_filename, vs->avf->url, hls);
     }
 }
 
@@ -1311,6 +1336,7 @@ static void hls_free_segments(HLSSegment *p)
 
 static int hls_rename_temp_file(AVFormatContext *s, AVFormatContext *oc)
 {
+    HLSContext *hls = s->priv_data;
     size_t len = strlen(oc->url);
     char *final_filename = av_strdup(oc->url);
     int ret;
@@ -1318,7 +1344,7 @@ static int hls_rename_temp_file(AVFormatContext *s, AVFormatContext *oc)
     if (!final_filename)
         return AVERROR(ENOMEM);
     final_filename[len-4] = '\0';
-    ret = ff_rename(oc->url, final_filename, s);
+    ret = ff_segment_writer_rename(hls->writer, oc->url, final_filename, s);
     oc->url[len-4] = '\0';
     av_freep(&final_filename);
     return ret;
@@ -1397,7 +1423,7 @@ static int create_master_playlist(AVFormatContext *s,
 
     set_http_options(s, &options, hls);
     snprintf(temp_filename, sizeof(temp_filename), use_temp_file ? "%s.tmp" : "%s", hls->master_m3u8_url);
-    ret = hlsenc_io_open(s, &hls->m3u8_out, temp_filename, &options);
+    ret = hlsenc_file_open(s, &hls->m3u8_out, temp_filename, &options);
     av_dict_free(&options);
     if (ret < 0) {
         av_log(s, AV_LOG_ERROR, "Failed to open master play list file '%s'\n",
@@ -1534,9 +1560,9 @@ static int create_master_playlist(AVFormatContext *s,
 fail:
     if (ret >=0)
         hls->master_m3u8_created = 1;
-    hlsenc_io_close(s, &hls->m3u8_out, temp_filename);
+    hlsenc_file_close(s, &hls->m3u8_out, temp_filename, FF_SEGMENT_WRITE_ORDERED);
     if (use_temp_file)
-        ff_rename(temp_filename, hls->master_m3u8_url, s);
+        ff_segment_writer_rename(hls->writer, temp_filename, hls->master_m3u8_url, s);
 
     return ret;
 }
@@ -1588,7 +1614,7 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
 
     set_http_options(s, &options, hls);
     snprintf(temp_filename, sizeof(temp_filename), use_temp_file ? "%s.tmp" : "%s", vs->m3u8_name);
-    ret = hlsenc_io_open(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename, &options);
+    ret = hlsenc_file_open(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename, &options);
     av_dict_free(&options);
     if (ret < 0) {
         goto fail;
@@ -1645,7 +1671,7 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     if (vs->vtt_m3u8_name) {
         set_http_options(vs->vtt_avf, &options, hls);
         snprintf(temp_vtt_filename, sizeof(temp_vtt_filename), use_temp_file ? "%s.tmp" : "%s", vs->vtt_m3u8_name);
-        ret = hlsenc_io_open(s, &hls->sub_m3u8_out, temp_vtt_filename, &options);
+        ret = hlsenc_file_open(s, &hls->sub_m3u8_out, temp_vtt_filename, &options);
         av_dict_free(&options);
         if (ret < 0) {
             goto fail;
@@ -1668,15 +1694,17 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
 
 fail:
     av_dict_free(&options);
-    ret = hlsenc_io_close(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename);
+    ret = hlsenc_file_close(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename,
+                            FF_SEGMENT_WRITE_ORDERED);
     if (ret < 0) {
+        ff_segment_writer_discard(hls->writer, &hls->sub_m3u8_out);
         return ret;
     }
-    hlsenc_io_close(s, &hls->sub_m3u8_out, vs->vtt_m3u8_name);
+    hlsenc_file_close(s, &hls->sub_m3u8_out, vs->vtt_m3u8_name, FF_SEGMENT_WRITE_ORDERED);
     if (use_temp_file) {
-        ff_rename(temp_filename, vs->m3u8_name, s);
+        ff_segment_writer_rename(hls->writer, temp_filename, vs->m3u8_name, s);
         if (vs->vtt_m3u8_name)
-            ff_rename(temp_vtt_filename, vs->vtt_m3u8_name, s);
+            ff_segment_writer_rename(hls->writer, temp_vtt_filename, vs->vtt_m3u8_name, s);
     }
     if (ret >= 0 && hls->master_pl_name)
         if (create_master_playlist(s, vs, last) < 0)
@@ -2584,7 +2612,7 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
 
                 set_http_options(s, &options, hls);
 
-                ret = hlsenc_io_open(s, &vs->out, filename, &options);
+                ret = hlsenc_file_open(s, &vs->out, filename, &options);
                 if (ret < 0) {
                     av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
                            "Failed to open file '%s'\n", filename);
@@ -2602,8 +2630,8 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
                     return ret;
                 }
                 vs->size = range_length;
-                ret = hlsenc_io_close(s, &vs->out, filename);
-                if (ret < 0) {
+                ret = hlsenc_file_close(s, &vs->out, filename, 0);
+                if (ret < 0 && !hls->writer) {
                     av_log(s, AV_LOG_WARNING, "upload segment failed,"
                            " will retry with a new http session.\n");
                     ff_format_io_close(s, &vs->out);
@@ -2622,6 +2650,9 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
                 hls_rename_temp_file(s, oc);
         }
 
+        /* errors of segments and playlists written in the background */
+        if (ret >= 0 && !hls->ignore_io_errors)
+            ret = ff_segment_writer_error(hls->writer);
         if (ret < 0)
             return ret;
 
@@ -2709,6 +2740,7 @@ static void hls_deinit(AVFormatContext *s)
     for (i = 0; i < hls->nb_varstreams; i++) {
         vs = &hls->var_streams[i];
 
+        ff_segment_writer_discard(hls->writer, &vs->out);
         av_freep(&vs->basename);
         av_freep(&vs->base_output_dirname);
         av_freep(&vs->fmp4_init_filename);
@@ -2725,6 +2757,9 @@ static void hls_deinit(AVFormatContext *s)
         av_freep(&vs->streams);
     }
 
+    ff_segment_writer_discard(hls->writer, &hls->m3u8_out);
+    ff_segment_writer_discard(hls->writer, &hls->sub_m3u8_out);
+    ff_segment_writer_free(&hls->writer);
     ff_format_io_close(s, &hls->m3u8_out);
     ff_format_io_close(s, &hls->sub_m3u8_out);
     ff_format_io_close(s, &hls->http_delete);
@@ -2793,7 +2828,7 @@ static int hls_write_trailer(struct AVFormatContext *s)
         }
         if (!(hls->flags & HLS_SINGLE_FILE)) {
             set_http_options(s, &options, hls);
-            ret = hlsenc_io_open(s, &vs->out, filename, &options);
+            ret = hlsenc_file_open(s, &vs->out, filename, &options);
             if (ret < 0) {
                 av_log(s, AV_LOG_ERROR, "Failed to open file '%s'\n", oc->url);
                 goto failed;
@@ -2806,8 +2841,8 @@ static int hls_write_trailer(struct AVFormatContext *s)
             goto failed;
 
         vs->size = range_length;
-        ret = hlsenc_io_close(s, &vs->out, filename);
-        if (ret < 0) {
+        ret = hlsenc_file_close(s, &vs->out, filename, 0);
+        if (ret < 0 && !hls->writer) {
             av_log(s, AV_LOG_WARNING, "upload segment failed, will retry with a new http session.\n");
             ff_format_io_close(s, &vs->out);
             ret = hlsenc_io_open(s, &vs->out, filename, &options);
@@ -2869,7 +2904,8 @@ failed:
         av_free(old_filename);
     }
 
-    return 0;
+    ret = ff_segment_writer_flush(hls->writer);
+    return hls->ignore_io_errors ? 0 : ret;
 }
 
 
@@ -2907,6 +2943,21 @@ static int hls_init(AVFormatContext *s)
         av_log(hls, AV_LOG_WARNING, "No HTTP method set, hls muxer defaulting to method PUT.\n");
     }
 
+    if (hls->write_threads) {
+        if ((hls->flags & HLS_SINGLE_FILE) || hls->max_seg_size > 0) {
+            av_log(s, AV_LOG_WARNING, "write_threads is not supported with single_file "
+                   "or hls_segment_size, writing on the muxing thread\n");
+        } else {
+            ret = ff_segment_writer_alloc(&hls->writer, s, hls->write_threads,
+                                          hls->max_pending_writes);
+            if (ret == AVERROR(ENOSYS))
+                av_log(s, AV_LOG_WARNING, "write_threads needs thread support, "
+                       "writing on the muxing thread\n");
+            else if (ret < 0)
+                return ret;
+        }
+    }
+
     ret = validate_name(hls->nb_varstreams, s->url);
     if (ret < 0)
         return ret;
@@ -3187,6 +3238,8 @@ static const AVOption options[] = {
     {"timeout", "set timeout for socket I/O operations", OFFSET(timeout), AV_OPT_TYPE_DURATION, { .i64 = -1 }, -1, INT_MAX, .flags = E },
     {"ignore_io_errors", "Ignore IO errors for stable long-duration runs with network output", OFFSET(ignore_io_errors), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     {"headers", "set custom HTTP headers, can override built in default headers", OFFSET(headers), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
+    {"write_threads", "number of threads writing segments and playlists in the background", OFFSET(write_threads), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 64, E },
+    {"max_pending_writes", "maximum number of segments and playlists waiting to be written", OFFSET(max_pending_writes), AV_OPT_TYPE_INT, { .i64 = 4 }, 1, INT_MAX, E },
     { NULL },
 };
 
@@ -188,6 +188,7 @@ typedef struct MOVStreamContext {
     unsigned int tts_count;
     unsigned int tts_allocated_size;
     MOVTimeToSample *tts_data;
+    int tts_runs;               ///< tts_data entries may describe more than one sample
     unsigned int stts_count;
     unsigned int stts_allocated_size;
     MOVStts *stts_data;
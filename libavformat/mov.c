@@ -4759,24 +4759,24 @@ static void mov_fix_index(MOVContext *mov, AVStream *st)
             // Break when found first key frame after edit entry completion
             if ((curr_cts + frame_duration >= (edit_list_duration + edit_list_media_time)) &&
                 ((flags & AVINDEX_KEYFRAME) || ((st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)))) {
-                if (msc->ctts_count) {
-                    // If we have CTTS and this is the first keyframe after edit elist,
-                    // wait for one more, because there might be trailing B-frames after this I-frame
-                    // that do belong to the edit.
-                    if (st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO && found_keyframe_after_edit == 0) {
-                        found_keyframe_after_edit = 1;
-                        continue;
-                    }
-                    if (tts_sample_old != 0) {
-                        if (add_tts_entry(&msc->tts_data, &msc->tts_count,
-                                           &msc->tts_allocated_size,
-                                           tts_sample_old - edit_list_start_tts_sample,
-                                           tts_data_old[tts_index_old].offset, tts_data_old[tts_index_old].duration) == -1) {
-                            av_log(mov->fc, AV_LOG_ERROR, "Cannot add Time To Sample entry %"PRId64" - {%"PRId64", %d}\n",
-                                   tts_index_old, tts_sample_old - edit_list_start_tts_sample,
-                                   tts_data_old[tts_index_old].offset);
-                            break;
-                        }
+                // If we have CTTS and this is the first keyframe after edit elist,
+                // wait for one more, because there might be trailing B-frames after this I-frame
+                // that do belong to the edit.
+                if (msc->ctts_count && st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO &&
+                    found_keyframe_after_edit == 0) {
+                    found_keyframe_after_edit = 1;
+                    continue;
+                }
+                // Flush the partially consumed entry, entries are runs of samples with or without CTTS
+                if (tts_sample_old != 0) {
+                    if (add_tts_entry(&msc->tts_data, &msc->tts_count,
+                                       &msc->tts_allocated_size,
+                                       tts_sample_old - edit_list_start_tts_sample,
+                                       tts_data_old[tts_index_old].offset, tts_data_old[tts_index_old].duration) == -1) {
+                        av_log(mov->fc, AV_LOG_ERROR, "Cannot add Time To Sample entry %"PRId64" - {%"PRId64", %d}\n",
+                               tts_index_old, tts_sample_old - edit_list_start_tts_sample,
+                               tts_data_old[tts_index_old].offset);
+                        break;
                     }
                 }
                 break;
@@ -4887,6 +4887,11 @@ static int build_open_gop_key_points(AVStream *st)
     return 0;
 }
 
+/* Number of samples described by a stts or ctts table, capped at sample_count */
+#define TTS_COVERED_SAMPLES(data, nb_entries, sample_count, covered)          \
+    for (unsigned int i = 0; i < (nb_entries) && (covered) < (sample_count); i++) \
+        (covered) += FFMIN((data)[i].count, (sample_count) - (covered))
+
 #define MOV_MERGE_CTTS 1
 #define MOV_MERGE_STTS 2
 /*
@@ -4899,61 +4904,122 @@ static int mov_merge_tts_data(MOVContext *mov, AVStream *st, int flags)
     MOVStreamContext *sc = st->priv_data;
     int ctts = sc->ctts_data && (flags & MOV_MERGE_CTTS);
     int stts = sc->stts_data && (flags & MOV_MERGE_STTS);
-    int idx = 0;
+    unsigned int ctts_covered = 0, stts_covered = 0, total;
+    unsigned int ctts_index = 0, ctts_sample = 0;
+    unsigned int stts_index = 0, stts_sample = 0;
+    int ret = 0;
 
     if (!sc->ctts_data && !sc->stts_data)
         return 0;
-    // Expand time to sample entries such that we have a 1-1 mapping with samples
     if (!sc->sample_count || sc->sample_count >= UINT_MAX / sizeof(*sc->tts_data))
         return -1;
 
-    if (ctts) {
-        sc->tts_data = av_fast_realloc(NULL, &sc->tts_allocated_size,
-                                       sc->sample_count * sizeof(*sc->tts_data));
-        if (!sc->tts_data)
-            return -1;
-
-        memset(sc->tts_data, 0, sc->tts_allocated_size);
+    if (ctts)
+        TTS_COVERED_SAMPLES(sc->ctts_data, sc->ctts_count, sc->sample_count, ctts_covered);
+    if (stts)
+        TTS_COVERED_SAMPLES(sc->stts_data, sc->stts_count, sc->sample_count, stts_covered);
+    total = FFMAX(ctts_covered, stts_covered);
 
-        for (int i = 0; i < sc->ctts_count &&
-                    idx < sc->sample_count; i++)
-            for (int j = 0; j < sc->ctts_data[i].count &&
-                        idx < sc->sample_count; j++) {
-                sc->tts_data[idx].offset = sc->ctts_data[i].offset;
-                sc->tts_data[idx++].count = 1;
+    /* Merge the runs of both tables rather than expanding them to one entry
+     * per sample, samples which are not covered by a table get zero values.
+     * Samples added later by trun boxes need the expanded form, see
+     * mov_expand_tts_data(). */
+    av_freep(&sc->tts_data);
+    sc->tts_allocated_size = 0;
+    sc->tts_count = 0;
+    for (unsigned int idx = 0, n; idx < total; idx += n) {
+        unsigned int duration = 0;
+        int offset = 0;
+
+        n = total - idx;
+        if (ctts) {
+            while (ctts_index < sc->ctts_count && ctts_sample == sc->ctts_data[ctts_index].count) {
+                ctts_index++;
+                ctts_sample = 0;
+            }
+            if (ctts_index < sc->ctts_count) {
+                n      = FFMIN(n, sc->ctts_data[ctts_index].count - ctts_sample);
+                offset = sc->ctts_data[ctts_index].offset;
+            }
+        }
+        if (stts) {
+            while (stts_index < sc->stts_count && stts_sample == sc->stts_data[stts_index].count) {
+                stts_index++;
+                stts_sample = 0;
             }
+            if (stts_index < sc->stts_count) {
+                n        = FFMIN(n, sc->stts_data[stts_index].count - stts_sample);
+                duration = sc->stts_data[stts_index].duration;
+            }
+        }
+        if (ctts && ctts_index < sc->ctts_count)
+            ctts_sample += n;
+        if (stts && stts_index < sc->stts_count)
+            stts_sample += n;
 
-        sc->tts_count = idx;
-    } else
+        if (sc->tts_count &&
+            sc->tts_data[sc->tts_count - 1].offset   == offset &&
+            sc->tts_data[sc->tts_count - 1].duration == duration) {
+            sc->tts_data[sc->tts_count - 1].count += n;
+        } else if (add_tts_entry(&sc->tts_data, &sc->tts_count, &sc->tts_allocated_size,
+                                 n, offset, duration) < 0) {
+            ret = -1;
+            break;
+        }
+    }
+    sc->tts_runs = sc->tts_count < total;
+
+    if (!ctts)
         sc->ctts_count = 0;
     av_freep(&sc->ctts_data);
     sc->ctts_allocated_size = 0;
+    if (!stts)
+        sc->stts_count = 0;
+    av_freep(&sc->stts_data);
+    sc->stts_allocated_size = 0;
 
-    idx = 0;
-    if (stts) {
-        MOVTimeToSample *tts_data = av_fast_realloc(sc->tts_data, &sc->tts_allocated_size,
-                                                    sc->sample_count * sizeof(*sc->tts_data));
-        if (!tts_data)
-            return -1;
+    return ret;
+}
 
-        if (!sc->tts_data)
-            memset(tts_data, 0, sc->tts_allocated_size);
-        sc->tts_data = tts_data;
+/**
+ * Expand the time to sample entries to one entry per sample, as needed to
+ * insert samples in the middle of the table.
+ */
+static int mov_expand_tts_data(MOVStreamContext *sc)
+{
+    MOVTimeToSample *tts_data = NULL;
+    unsigned int allocated_size = 0, idx = 0;
+    uint64_t count = 0;
+    int tts_index = 0;
 
-        for (int i = 0; i < sc->stts_count &&
-                    idx < sc->sample_count; i++)
-            for (int j = 0; j < sc->stts_data[i].count &&
-                        idx < sc->sample_count; j++) {
-                sc->tts_data[idx].duration = sc->stts_data[i].duration;
-                sc->tts_data[idx++].count = 1;
-            }
+    for (unsigned int i = 0; i < sc->tts_count; i++)
+        count += sc->tts_data[i].count;
+    if (count >= UINT_MAX / sizeof(*tts_data))
+        return AVERROR_INVALIDDATA;
 
-        sc->tts_count = FFMAX(sc->tts_count, idx);
-    } else
-        sc->stts_count = 0;
-    av_freep(&sc->stts_data);
-    sc->stts_allocated_size = 0;
+    if (count) {
+        tts_data = av_fast_realloc(NULL, &allocated_size, count * sizeof(*tts_data));
+        if (!tts_data)
+            return AVERROR(ENOMEM);
+    }
+    for (unsigned int i = 0; i < sc->tts_count; i++) {
+        if (i == sc->tts_index)
+            tts_index = idx + sc->tts_sample;
+        for (unsigned int j = 0; j < sc->tts_data[i].count; j++) {
+            tts_data[idx] = sc->tts_data[i];
+            tts_data[idx++].count = 1;
+        }
+    }
+    if (sc->tts_index >= sc->tts_count)
+        tts_index = idx;
 
+    av_free(sc->tts_data);
+    sc->tts_data           = tts_data;
+    sc->tts_allocated_size = allocated_size;
+    sc->tts_count          = idx;
+    sc->tts_index          = tts_index;
+    sc->tts_sample         = 0;
+    sc->tts_runs           = 0;
     return 0;
 }
 
@@ -5369,6 +5435,7 @@ static void mov_update_sample_durations(MOVContext *mov, AVStream *st)
     sc->tts_data = tts_data;
     sc->tts_count = count;
     sc->tts_allocated_size = count * sizeof(*tts_data);
+    sc->tts_runs = 0;
     tts_data = NULL;
 
 fail:
@@ -5655,8 +5722,16 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         }
 
 #if FF_API_R_FRAME_RATE
-        for (unsigned int i = 1; sc->stts_count && i + 1 < sc->tts_count; i++) {
-            if (sc->tts_data[i].duration == sc->tts_data[0].duration)
+        int64_t nb_samples = 0, first = 0;
+        for (unsigned int i = 0; sc->stts_count && i < sc->tts_count; i++)
+            nb_samples += sc->tts_data[i].count;
+        /* entries may cover several samples, the first and the last sample
+         * are not taken into account */
+        for (unsigned int i = 0; sc->stts_count && i < sc->tts_count; i++) {
+            int64_t start = FFMAX(first, 1);
+            int64_t end   = FFMIN(first + sc->tts_data[i].count, nb_samples - 1);
+            first += sc->tts_data[i].count;
+            if (start >= end || sc->tts_data[i].duration == sc->tts_data[0].duration)
                 continue;
             stts_constant = 0;
         }
@@ -6197,7 +6272,7 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     int64_t dts, pts = AV_NOPTS_VALUE;
     int data_offset = 0;
     unsigned entries, first_sample_flags = frag->flags;
-    int flags, distance, i;
+    int flags, distance, i, ret;
     int64_t prev_dts = AV_NOPTS_VALUE;
     int next_frag_index = -1, index_entry_pos;
     size_t requested_size;
@@ -6248,6 +6323,8 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     entries = avio_rb32(pb);
     av_log(c->fc, AV_LOG_TRACE, "flags 0x%x entries %u\n", flags, entries);
 
+    if (sc->tts_runs && (ret = mov_expand_tts_data(sc)) < 0)
+        return ret;
     if ((uint64_t)entries+sc->tts_count >= UINT_MAX/sizeof(*sc->tts_data))
         return AVERROR_INVALIDDATA;
     if (flags & MOV_TRUN_DATA_OFFSET)        data_offset        = avio_rb32(pb);
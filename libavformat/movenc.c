@@ -6570,6 +6570,77 @@ static void mov_parse_truehd_frame(AVPacket *pkt, MOVTrack *trk)
     return;
 }
 
+/* Size of the fragment data of a track, including referenced packets */
+static int64_t mov_mdat_tell(const MOVTrack *track)
+{
+    return avio_tell(track->mdat_buf) + track->mdat_chunks_size;
+}
+
+static MOVMdatChunk *mov_mdat_add_chunk(MOVTrack *track)
+{
+    MOVMdatChunk *chunks = av_fast_realloc(track->mdat_chunks, &track->mdat_chunks_allocated,
+                                           (track->nb_mdat_chunks + 1) * sizeof(*chunks));
+    if (!chunks)
+        return NULL;
+    track->mdat_chunks = chunks;
+    return &chunks[track->nb_mdat_chunks++];
+}
+
+/**
+ * Add the data of a packet to the fragment by reference, instead of copying
+ * it into the track mdat_buf.
+ */
+static int mov_mdat_add_packet(MOVTrack *track, const AVPacket *pkt)
+{
+    int64_t pos = avio_tell(track->mdat_buf);
+    MOVMdatChunk *chunk;
+
+    /* keep the data written to mdat_buf so far in order */
+    if (pos > track->mdat_buf_pos) {
+        if (!(chunk = mov_mdat_add_chunk(track)))
+            return AVERROR(ENOMEM);
+        chunk->buf    = NULL;
+        chunk->offset = track->mdat_buf_pos;
+        chunk->size   = pos - track->mdat_buf_pos;
+        track->mdat_buf_pos = pos;
+    }
+
+    if (!(chunk = mov_mdat_add_chunk(track)))
+        return AVERROR(ENOMEM);
+    if (!(chunk->buf = av_buffer_ref(pkt->buf))) {
+        track->nb_mdat_chunks--;
+        return AVERROR(ENOMEM);
+    }
+    chunk->data = pkt->data;
+    chunk->size = pkt->size;
+    track->mdat_chunks_size += pkt->size;
+    return 0;
+}
+
+static void mov_mdat_free_chunks(MOVTrack *track)
+{
+    for (int i = 0; i < track->nb_mdat_chunks; i++)
+        av_buffer_unref(&track->mdat_chunks[i].buf);
+    track->nb_mdat_chunks   = 0;
+    track->mdat_chunks_size = 0;
+    track->mdat_buf_pos     = 0;
+}
+
+/* Write the fragment data of a track and reset it */
+static void mov_mdat_write(AVIOContext *pb, MOVTrack *track)
+{
+    uint8_t *buf;
+    int buf_size = avio_get_dyn_buf(track->mdat_buf, &buf);
+
+    for (int i = 0; i < track->nb_mdat_chunks; i++) {
+        const MOVMdatChunk *chunk = &track->mdat_chunks[i];
+        avio_write(pb, chunk->buf ? chunk->data : buf + chunk->offset, chunk->size);
+    }
+    avio_write(pb, buf + track->mdat_buf_pos, buf_size - track->mdat_buf_pos);
+    ffio_reset_dyn_buf(track->mdat_buf);
+    mov_mdat_free_chunks(track);
+}
+
 static int mov_flush_fragment_interleaving(AVFormatContext *s, MOVTrack *track)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -6837,7 +6908,7 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
         if (!track->entry)
             continue;
         if (track->mdat_buf)
-            mdat_size += avio_tell(track->mdat_buf);
+            mdat_size += mov_mdat_tell(track);
         if (first_track < 0)
             first_track = i;
     }
@@ -6857,7 +6928,7 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
         if (!track->entry)
             continue;
         if (mov->flags & FF_MOV_FLAG_SEPARATE_MOOF) {
-            mdat_size = avio_tell(track->mdat_buf);
+            mdat_size = mov_mdat_tell(track);
             moof_tracks = i;
         } else {
             write_moof = i == first_track;
@@ -6881,9 +6952,7 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
         if (!mov->frag_interleave) {
             if (!track->mdat_buf)
                 continue;
-            buf_size = avio_get_dyn_buf(track->mdat_buf, &buf);
-            avio_write(s->pb, buf, buf_size);
-            ffio_reset_dyn_buf(track->mdat_buf);
+            mov_mdat_write(s->pb, track);
         } else {
             if (!mov->mdat_buf)
                 continue;
@@ -7246,6 +7315,10 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
             if (ret) {
                 goto err;
             }
+        } else if (pb == trk->mdat_buf && pkt->buf && !mov->frag_interleave) {
+            /* the fragment is written from the packet buffers on flush */
+            if ((ret = mov_mdat_add_packet(trk, pkt)) < 0)
+                goto err;
         } else {
             avio_write(pb, pkt->data, size);
         }
@@ -7262,7 +7335,8 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
         trk->cluster_capacity = new_capacity;
     }
 
-    trk->cluster[trk->entry].pos              = avio_tell(pb) - size;
+    trk->cluster[trk->entry].pos              = (pb == trk->mdat_buf ? mov_mdat_tell(trk) :
+                                                 avio_tell(pb)) - size;
     trk->cluster[trk->entry].stsd_index       = trk->last_stsd_index;
     trk->cluster[trk->entry].samples_in_chunk = samples_in_chunk;
     trk->cluster[trk->entry].chunkNum         = 0;
@@ -7987,6 +8061,8 @@ static void mov_free(AVFormatContext *s)
 
         ff_mov_cenc_free(&track->cenc);
         ffio_free_dyn_buf(&track->mdat_buf);
+        mov_mdat_free_chunks(track);
+        av_freep(&track->mdat_chunks);
 
 #if CONFIG_IAMFENC
         ffio_free_dyn_buf(&track->iamf_buf);
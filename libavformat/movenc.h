@@ -85,6 +85,13 @@ typedef struct MOVFragmentInfo {
     int size;
 } MOVFragmentInfo;
 
+typedef struct MOVMdatChunk {
+    AVBufferRef *buf;       ///< referenced packet data, NULL for data in mdat_buf
+    const uint8_t *data;
+    int64_t     offset;     ///< offset of the data in mdat_buf, if buf is NULL
+    int         size;
+} MOVMdatChunk;
+
 typedef struct MovTag {
     uint32_t    name;
     int         nb_id;
@@ -157,6 +164,11 @@ typedef struct MOVTrack {
     AVPacket *cover_image;
 
     AVIOContext *mdat_buf;
+    MOVMdatChunk *mdat_chunks;      ///< fragment data, in order, when packets are referenced
+    int         nb_mdat_chunks;
+    unsigned    mdat_chunks_allocated;
+    int64_t     mdat_chunks_size;   ///< size of the packets referenced in mdat_chunks
+    int64_t     mdat_buf_pos;       ///< end of the mdat_buf data covered by mdat_chunks
     int64_t     data_offset;
     int         frag_discont;
     int         entries_flushed;
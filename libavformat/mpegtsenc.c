@@ -44,6 +44,9 @@
 
 #define PCR_TIME_BASE 27000000
 
+/* number of TS packets written to the output with a single avio_write() */
+#define TS_BATCH_PACKETS 64
+
 /* write DVB SI sections */
 
 #define DVB_PRIVATE_NETWORK_START 0xff01
@@ -136,6 +139,10 @@ typedef struct MpegTSWrite {
     int pcr_pid;            ///< user-specified separate PCR PID (-1 = use video PID)
     int64_t pcr_stream_pcr_period; ///< PCR period for the dedicated stream
     int64_t pcr_stream_last_pcr;   ///< last PCR sent on the dedicated PID
+
+    /* TS packets (with their m2ts header) assembled since the last write */
+    uint8_t batch[TS_BATCH_PACKETS * (TS_PACKET_SIZE + 4)];
+    int batch_size;
 } MpegTSWrite;
 
 /* a PES packet header is generated every DEFAULT_PES_HEADER_FREQ packets */
@@ -973,18 +980,41 @@ static int64_t get_pcr(const MpegTSWrite *ts)
            ts->first_pcr;
 }
 
+static void flush_batch(AVFormatContext *s)
+{
+    MpegTSWrite *ts = s->priv_data;
+
+    if (ts->batch_size) {
+        avio_write(s->pb, ts->batch, ts->batch_size);
+        ts->batch_size = 0;
+    }
+}
+
+/**
+ * Return the space for the next TS packet in the batch buffer, so that it
+ * can be assembled in place and passed to write_packet() without a copy.
+ */
+static uint8_t *get_packet_buf(MpegTSWrite *ts)
+{
+    return ts->batch + ts->batch_size + (ts->m2ts_mode ? 4 : 0);
+}
+
 static void write_packet(AVFormatContext *s, const uint8_t *packet)
 {
     MpegTSWrite *ts = s->priv_data;
+    uint8_t *dst = ts->batch + ts->batch_size;
+
     if (ts->m2ts_mode) {
-        int64_t pcr = get_pcr(s->priv_data);
-        uint32_t tp_extra_header = pcr % 0x3fffffff;
-        tp_extra_header = AV_RB32(&tp_extra_header);
-        avio_write(s->pb, (unsigned char *) &tp_extra_header,
-                   sizeof(tp_extra_header));
+        AV_WB32(dst, get_pcr(ts) % 0x3fffffff);
+        dst += 4;
     }
-    avio_write(s->pb, packet, TS_PACKET_SIZE);
+    if (packet != dst)
+        memcpy(dst, packet, TS_PACKET_SIZE);
+    ts->batch_size  = dst + TS_PACKET_SIZE - ts->batch;
     ts->total_size += TS_PACKET_SIZE;
+
+    if (ts->batch_size > sizeof(ts->batch) - (TS_PACKET_SIZE + 4))
+        flush_batch(s);
 }
 
 static void section_write_packet(MpegTSSection *s, const uint8_t *packet)
@@ -1382,8 +1412,8 @@ static int write_pcr_bits(uint8_t *buf, int64_t pcr)
 /* Write a single null transport stream packet */
 static void mpegts_insert_null_packet(AVFormatContext *s)
 {
+    uint8_t *buf = get_packet_buf(s->priv_data);
     uint8_t *q;
-    uint8_t buf[TS_PACKET_SIZE];
 
     q    = buf;
     *q++ = SYNC_BYTE;
@@ -1399,8 +1429,8 @@ static void mpegts_insert_pcr_only_pid(AVFormatContext *s, int pid, int cc,
                                        int discontinuity)
 {
     MpegTSWrite *ts = s->priv_data;
+    uint8_t *buf = get_packet_buf(ts);
     uint8_t *q;
-    uint8_t buf[TS_PACKET_SIZE];
 
     q    = buf;
     *q++ = SYNC_BYTE;
@@ -1516,8 +1546,7 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
 {
     MpegTSWriteStream *ts_st = st->priv_data;
     MpegTSWrite *ts = s->priv_data;
-    uint8_t buf[TS_PACKET_SIZE];
-    uint8_t *q;
+    uint8_t *buf, *q;
     int val, is_start, len, header_len, write_pcr, flags;
     int afc_len, stuffing_len;
     int is_dvb_subtitle = (st->codecpar->codec_id == AV_CODEC_ID_DVB_SUBTITLE);
@@ -1527,7 +1556,6 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
     int force_sdt = 0;
     int force_nit = 0;
 
-    av_assert0(ts_st->payload != buf || st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO);
     if (ts->flags & MPEGTS_FLAG_PAT_PMT_AT_FRAMES && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
         force_pat = 1;
     }
@@ -1618,7 +1646,9 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
             }
         }
 
-        /* prepare packet header */
+        /* prepare packet header, in place in the batch buffer since all
+         * other packets have been written by now */
+        buf  = get_packet_buf(ts);
         q    = buf;
         *q++ = SYNC_BYTE;
         val  = ts_st->pid >> 8;
@@ -2302,20 +2332,25 @@ static void mpegts_write_flush(AVFormatContext *s)
     }
 
     if (ts->m2ts_mode) {
-        int packets = (avio_tell(s->pb) / (TS_PACKET_SIZE + 4)) % 32;
+        int packets = ((avio_tell(s->pb) + ts->batch_size) / (TS_PACKET_SIZE + 4)) % 32;
         while (packets++ < 32)
             mpegts_insert_null_packet(s);
     }
+    flush_batch(s);
 }
 
 static int mpegts_write_packet(AVFormatContext *s, AVPacket *pkt)
 {
+    int ret;
+
     if (!pkt) {
         mpegts_write_flush(s);
         return 1;
-    } else {
-        return mpegts_write_packet_internal(s, pkt);
     }
+    ret = mpegts_write_packet_internal(s, pkt);
+    /* the packets of one call are written together */
+    flush_batch(s);
+    return ret;
 }
 
 static int mpegts_write_end(AVFormatContext *s)
@@ -57,8 +57,10 @@
 #include "libavcodec/defs.h"
 #include "libavcodec/internal.h"
 #include "libavutil/channel_layout.h"
+#include "libavutil/crc.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/time.h"
 #include "libavutil/timecode.h"
 #include "libavutil/opt.h"
 #include "avformat.h"
@@ -67,9 +69,11 @@
 #include "demux.h"
 #include "internal.h"
 #include "mxf.h"
+#include "url.h"
 
 #define MXF_MAX_CHUNK_SIZE (32 << 20)
 #define RUN_IN_MAX (65535+1)  // S377m-2004 section 5.5 and S377-1-2009 section 6.5, the +1 is to be slightly more tolerant
+#define MXF_FOLLOW_POLL_US 100000
 
 typedef enum {
     Header,
@@ -297,6 +301,8 @@ typedef struct MXFIndexTable {
     MXFIndexTableSegment **segments;    /* sorted by IndexStartPosition */
     AVIndexEntry *fake_index;   /* used for calling ff_index_search_timestamp() */
     int8_t *offsets;            /* temporal offsets for display order to stored order conversion */
+    uint8_t *flags;             /* keyframe flags of the fake index in stored order */
+    int sort_from;              /* first segment with TemporalOffsets past the end of a growing index */
 } MXFIndexTable;
 
 typedef struct MXFContext {
@@ -323,6 +329,11 @@ typedef struct MXFContext {
     int nb_index_tables;
     MXFIndexTable *index_tables;
     int eia608_extract;
+    char *index_cache;
+    int follow;
+    int64_t follow_timeout;
+    int64_t follow_pos;     ///< end of the partitions and index segments parsed so far
+    int64_t follow_size;    ///< last known size of the growing file
 } MXFContext;
 
 /* NOTE: klv_offset is not set (-1) for local keys */
@@ -342,6 +353,8 @@ static const uint8_t mxf_avid_essence_element_key[]        = { 0x06,0x0e,0x2b,0x
 static const uint8_t mxf_canopus_essence_element_key[]     = { 0x06,0x0e,0x2b,0x34,0x01,0x02,0x01,0x0a,0x0e,0x0f,0x03,0x01 };
 static const uint8_t mxf_system_item_key_cp[]              = { 0x06,0x0e,0x2b,0x34,0x02,0x05,0x01,0x01,0x0d,0x01,0x03,0x01,0x04 };
 static const uint8_t mxf_system_item_key_gc[]              = { 0x06,0x0e,0x2b,0x34,0x02,0x53,0x01,0x01,0x0d,0x01,0x03,0x01,0x14 };
+static const uint8_t mxf_primer_pack_key[]                 = { 0x06,0x0e,0x2b,0x34,0x02,0x05,0x01,0x01,0x0d,0x01,0x02,0x01,0x01,0x05,0x01 };
+static const uint8_t mxf_index_table_segment_key[]         = { 0x06,0x0e,0x2b,0x34,0x02,0x53,0x01,0x01,0x0d,0x01,0x02,0x01,0x01,0x10,0x01 };
 static const uint8_t mxf_klv_key[]                         = { 0x06,0x0e,0x2b,0x34 };
 static const uint8_t mxf_apple_coll_prefix[]               = { 0x06,0x0e,0x2b,0x34,0x01,0x01,0x01,0x0e,0x0e,0x20,0x04,0x01,0x05,0x03,0x01 };
 
@@ -510,6 +523,14 @@ static int klv_read_packet(MXFContext *mxf, KLVPacket *klv, AVIOContext *pb)
     return 0;
 }
 
+/**
+ * @return non-zero if the file is being followed as it grows
+ */
+static int mxf_following(MXFContext *mxf)
+{
+    return mxf->follow && !mxf->footer_partition;
+}
+
 static int mxf_get_stream_index(AVFormatContext *s, KLVPacket *klv, int body_sid)
 {
     for (int i = 0; i < s->nb_streams; i++) {
@@ -2003,32 +2024,99 @@ static int mxf_edit_unit_absolute_offset(MXFContext *mxf, MXFIndexTable *index_t
     return AVERROR_INVALIDDATA;
 }
 
-static int mxf_compute_ptses_fake_index(MXFContext *mxf, MXFIndexTable *index_table)
+/**
+ * @return 1 if PTSes can be computed from the segment, 0 otherwise
+ */
+static int mxf_check_ptses_segment(MXFContext *mxf, MXFIndexTable *index_table, MXFIndexTableSegment *s)
 {
-    int i, j, x;
-    int8_t max_temporal_offset = -128;
-    uint8_t *flags;
+    if (!s->nb_index_entries)
+        return 0;                                   /* no TemporalOffsets */
 
-    /* first compute how many entries we have */
-    for (i = 0; i < index_table->nb_segments; i++) {
+    if (s->index_duration > INT_MAX - index_table->nb_ptses) {
+        av_log(mxf->fc, AV_LOG_ERROR, "ignoring IndexSID %d, duration is too large\n", s->index_sid);
+        return 0;
+    }
+
+    if (s->nb_index_entries != s->index_duration &&
+        s->nb_index_entries != s->index_duration + 1 &&  /* Avid index */
+        s->nb_index_entries != s->index_duration * 2 + 1) {
+        av_log(mxf->fc, AV_LOG_ERROR, "ignoring IndexSID %d, duration does not match nb_index_entries\n", s->index_sid);
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Bucket sorts the TemporalOffsets of the segments from first_segment on,
+ * the first of which starts at EditUnit x, into ptses.
+ * @return the smallest PTS written
+ */
+static int mxf_sort_ptses(MXFContext *mxf, MXFIndexTable *index_table, int first_segment, int x,
+                          int8_t *max_temporal_offset)
+{
+    int min_index = index_table->nb_ptses;
+
+    index_table->sort_from = index_table->nb_segments;
+
+    for (int i = first_segment; i < index_table->nb_segments; i++) {
         MXFIndexTableSegment *s = index_table->segments[i];
+        int index_delta = 1;
+        int n = s->nb_index_entries;
 
-        if (!s->nb_index_entries) {
-            index_table->nb_ptses = 0;
-            return 0;                               /* no TemporalOffsets */
-        }
+        if (s->nb_index_entries == 2 * s->index_duration + 1)
+            index_delta = 2;    /* Avid index */
+        if (s->nb_index_entries == index_delta * s->index_duration + 1)
+            /* ignore the last entry - it's the size of the essence container in Avid */
+            n--;
 
-        if (s->index_duration > INT_MAX - index_table->nb_ptses) {
-            index_table->nb_ptses = 0;
-            av_log(mxf->fc, AV_LOG_ERROR, "ignoring IndexSID %d, duration is too large\n", s->index_sid);
-            return 0;
+        for (int j = 0; j < n; j += index_delta, x++) {
+            int offset = s->temporal_offset_entries[j] / index_delta;
+            int index  = x + offset;
+
+            if (x >= index_table->nb_ptses) {
+                av_log(mxf->fc, AV_LOG_ERROR,
+                       "x >= nb_ptses - IndexEntryCount %i < IndexDuration %"PRId64"?\n",
+                       s->nb_index_entries, s->index_duration);
+                break;
+            }
+
+            index_table->flags[x] = !(s->flag_entries[j] & 0x30) ? AVINDEX_KEYFRAME : 0;
+
+            if (index >= index_table->nb_ptses && mxf_following(mxf)) {
+                /* sorted again once the next segments are read */
+                index_table->sort_from = FFMIN(index_table->sort_from, i);
+                continue;
+            }
+
+            if (index < 0 || index >= index_table->nb_ptses) {
+                av_log(mxf->fc, AV_LOG_ERROR,
+                       "index entry %i + TemporalOffset %i = %i, which is out of bounds\n",
+                       x, offset, index);
+                continue;
+            }
+
+            index_table->offsets[x] = offset;
+            index_table->ptses[index] = x;
+            *max_temporal_offset = FFMAX(*max_temporal_offset, offset);
+            min_index = FFMIN(min_index, index);
         }
+    }
+
+    return min_index;
+}
 
-        if (s->nb_index_entries != s->index_duration &&
-            s->nb_index_entries != s->index_duration + 1 &&  /* Avid index */
-            s->nb_index_entries != s->index_duration * 2 + 1) {
+static int mxf_compute_ptses_fake_index(MXFContext *mxf, MXFIndexTable *index_table)
+{
+    int x;
+    int8_t max_temporal_offset = -128;
+
+    /* first compute how many entries we have */
+    for (int i = 0; i < index_table->nb_segments; i++) {
+        MXFIndexTableSegment *s = index_table->segments[i];
+
+        if (!mxf_check_ptses_segment(mxf, index_table, s)) {
             index_table->nb_ptses = 0;
-            av_log(mxf->fc, AV_LOG_ERROR, "ignoring IndexSID %d, duration does not match nb_index_entries\n", s->index_sid);
             return 0;
         }
 
@@ -2041,8 +2129,8 @@ static int mxf_compute_ptses_fake_index(MXFContext *mxf, MXFIndexTable *index_ta
 
     if (!(index_table->ptses      = av_malloc_array(index_table->nb_ptses, sizeof(int64_t))) ||
         !(index_table->fake_index = av_calloc(index_table->nb_ptses, sizeof(AVIndexEntry))) ||
-        !(index_table->offsets    = av_malloc_array(index_table->nb_ptses, sizeof(int8_t))) ||
-        !(flags                   = av_malloc_array(index_table->nb_ptses, sizeof(uint8_t)))) {
+        !(index_table->offsets    = av_calloc(index_table->nb_ptses, sizeof(int8_t))) ||
+        !(index_table->flags      = av_malloc_array(index_table->nb_ptses, sizeof(uint8_t)))) {
         av_freep(&index_table->ptses);
         av_freep(&index_table->fake_index);
         av_freep(&index_table->offsets);
@@ -2081,50 +2169,76 @@ static int mxf_compute_ptses_fake_index(MXFContext *mxf, MXFIndexTable *index_ta
      * then settings ffstream(mxf)->first_dts = -max(TemporalOffset[x]).
      * The latter makes DTS <= PTS.
      */
-    for (i = x = 0; i < index_table->nb_segments; i++) {
-        MXFIndexTableSegment *s = index_table->segments[i];
-        int index_delta = 1;
-        int n = s->nb_index_entries;
+    mxf_sort_ptses(mxf, index_table, 0, 0, &max_temporal_offset);
 
-        if (s->nb_index_entries == 2 * s->index_duration + 1)
-            index_delta = 2;    /* Avid index */
-        if (s->nb_index_entries == index_delta * s->index_duration + 1)
-            /* ignore the last entry - it's the size of the essence container in Avid */
-            n--;
+    /* calculate the fake index table in display order */
+    for (x = 0; x < index_table->nb_ptses; x++) {
+        index_table->fake_index[x].timestamp = x;
+        if (index_table->ptses[x] != AV_NOPTS_VALUE)
+            index_table->fake_index[index_table->ptses[x]].flags = index_table->flags[x];
+    }
 
-        for (j = 0; j < n; j += index_delta, x++) {
-            int offset = s->temporal_offset_entries[j] / index_delta;
-            int index  = x + offset;
+    index_table->first_dts = -max_temporal_offset;
 
-            if (x >= index_table->nb_ptses) {
-                av_log(mxf->fc, AV_LOG_ERROR,
-                       "x >= nb_ptses - IndexEntryCount %i < IndexDuration %"PRId64"?\n",
-                       s->nb_index_entries, s->index_duration);
-                break;
-            }
+    return 0;
+}
 
-            flags[x] = !(s->flag_entries[j] & 0x30) ? AVINDEX_KEYFRAME : 0;
+/**
+ * Extends the PTSes and the fake index by the last segment of the index
+ * table, which was appended to it.
+ */
+static int mxf_extend_ptses_fake_index(MXFContext *mxf, MXFIndexTable *index_table)
+{
+    MXFIndexTableSegment *s = index_table->segments[index_table->nb_segments - 1];
+    int old_nb_ptses = index_table->nb_ptses, nb_ptses, x, min_index;
+    int8_t max_temporal_offset = -index_table->first_dts;
+    void *ptr;
 
-            if (index < 0 || index >= index_table->nb_ptses) {
-                av_log(mxf->fc, AV_LOG_ERROR,
-                       "index entry %i + TemporalOffset %i = %i, which is out of bounds\n",
-                       x, offset, index);
-                continue;
-            }
+    if (!old_nb_ptses)
+        return 0;
 
-            index_table->offsets[x] = offset;
-            index_table->ptses[index] = x;
-            max_temporal_offset = FFMAX(max_temporal_offset, offset);
-        }
+    if (!mxf_check_ptses_segment(mxf, index_table, s)) {
+        av_freep(&index_table->ptses);
+        av_freep(&index_table->fake_index);
+        av_freep(&index_table->offsets);
+        av_freep(&index_table->flags);
+        index_table->nb_ptses = 0;
+        return 0;
     }
+    nb_ptses = old_nb_ptses + s->index_duration;
 
-    /* calculate the fake index table in display order */
-    for (x = 0; x < index_table->nb_ptses; x++) {
+    /* the arrays may end up larger than nb_ptses on failure, which is harmless */
+    if (!(ptr = av_realloc_array(index_table->ptses, nb_ptses, sizeof(int64_t))))
+        return AVERROR(ENOMEM);
+    index_table->ptses = ptr;
+    if (!(ptr = av_realloc_array(index_table->fake_index, nb_ptses, sizeof(AVIndexEntry))))
+        return AVERROR(ENOMEM);
+    index_table->fake_index = ptr;
+    if (!(ptr = av_realloc_array(index_table->offsets, nb_ptses, sizeof(int8_t))))
+        return AVERROR(ENOMEM);
+    index_table->offsets = ptr;
+    if (!(ptr = av_realloc_array(index_table->flags, nb_ptses, sizeof(uint8_t))))
+        return AVERROR(ENOMEM);
+    index_table->flags = ptr;
+
+    for (x = old_nb_ptses; x < nb_ptses; x++)
+        index_table->ptses[x] = AV_NOPTS_VALUE;
+    memset(index_table->fake_index + old_nb_ptses, 0,
+           (nb_ptses - old_nb_ptses) * sizeof(*index_table->fake_index));
+    memset(index_table->offsets + old_nb_ptses, 0, nb_ptses - old_nb_ptses);
+    index_table->nb_ptses = nb_ptses;
+
+    /* sort again the entries that pointed past the previous end */
+    x = old_nb_ptses;
+    for (int i = index_table->sort_from; i < index_table->nb_segments - 1; i++)
+        x -= index_table->segments[i]->index_duration;
+    min_index = mxf_sort_ptses(mxf, index_table, index_table->sort_from, x, &max_temporal_offset);
+
+    for (x = FFMIN(min_index, old_nb_ptses); x < nb_ptses; x++) {
         index_table->fake_index[x].timestamp = x;
         if (index_table->ptses[x] != AV_NOPTS_VALUE)
-            index_table->fake_index[index_table->ptses[x]].flags = flags[x];
+            index_table->fake_index[index_table->ptses[x]].flags = index_table->flags[x];
     }
-    av_freep(&flags);
 
     index_table->first_dts = -max_temporal_offset;
 
@@ -3456,6 +3570,27 @@ static int mxf_parse_klv(MXFContext *mxf, KLVPacket klv, MXFMetadataReadFunc *re
     return 0;
 }
 
+/**
+ * Parses a KLV found while reading header metadata, skipping unknown keys
+ * @return <0 on error, 0 otherwise
+ */
+static int mxf_read_metadata_klv(MXFContext *mxf, KLVPacket klv)
+{
+    for (size_t x = 0; x < FF_ARRAY_ELEMS(mxf_metadata_read_table); x++) {
+        const MXFMetadataReadTableEntry *metadata = &mxf_metadata_read_table[x];
+        if (IS_KLV_KEY(klv.key, metadata->key)) {
+            if (metadata->read)
+                return mxf_parse_klv(mxf, klv, metadata->read, metadata->ctx_size, metadata->type);
+            avio_skip(mxf->fc->pb, klv.length);
+            return 0;
+        }
+    }
+    av_log(mxf->fc, AV_LOG_VERBOSE, "Dark key " PRIxUID "\n",
+                    UID_ARG(klv.key));
+    avio_skip(mxf->fc->pb, klv.length);
+    return 0;
+}
+
 /**
  * Seeks to the previous partition and parses it, if possible
  * @return <= 0 if we should stop parsing, > 0 if we should keep going
@@ -3777,12 +3912,338 @@ end:
     avio_seek(s->pb, mxf->run_in, SEEK_SET);
 }
 
+#define MXF_INDEX_CACHE_TAG     MKBETAG('M','X','F','I')
+#define MXF_INDEX_CACHE_VERSION 1
+
+/**
+ * Computes the key identifying the file a cache was built from: the CRC of
+ * the first and last partition packs. The file size is checked separately.
+ */
+static int mxf_index_cache_key(MXFContext *mxf, const MXFPartition *partitions,
+                               unsigned partitions_count, uint32_t key[2])
+{
+    AVIOContext *pb = mxf->fc->pb;
+    const AVCRC *table = av_crc_get_table(AV_CRC_32_IEEE_LE);
+    uint8_t buf[1024];
+
+    for (int i = 0; i < 2; i++) {
+        const MXFPartition *p = &partitions[i ? partitions_count - 1 : 0];
+        int64_t left = p->pack_length;
+        int64_t ret;
+
+        if ((ret = avio_seek(pb, p->pack_ofs, SEEK_SET)) < 0)
+            return ret;
+        key[i] = UINT32_MAX;
+        while (left > 0) {
+            int len = FFMIN(left, sizeof(buf));
+            if ((ret = ffio_read_size(pb, buf, len)) < 0)
+                return ret;
+            key[i] = av_crc(table, key[i], buf, len);
+            left  -= len;
+        }
+    }
+    return 0;
+}
+
+static void mxf_write_index_cache(AVFormatContext *s, int64_t essence_offset)
+{
+    MXFContext *mxf = s->priv_data;
+    MXFMetadataSetGroup *mg = &mxf->metadata_set_groups[IndexTableSegment];
+    int64_t file_size = avio_size(s->pb);
+    AVIOContext *pb = NULL;
+    uint32_t key[2];
+    char *tmp;
+    int ret;
+
+    /* the cache only replaces the partition walk, so the header partition
+     * must tell us where its header metadata is */
+    if (!(s->pb->seekable & AVIO_SEEKABLE_NORMAL) || file_size <= 0 ||
+        !mxf->partitions_count || mxf->partitions[0].type != Header ||
+        !mxf->partitions[0].header_byte_count)
+        return;
+
+    if (mxf_index_cache_key(mxf, mxf->partitions, mxf->partitions_count, key) < 0)
+        return;
+
+    tmp = av_asprintf("%s.tmp", mxf->index_cache);
+    if (!tmp)
+        return;
+
+    if ((ret = s->io_open(s, &pb, tmp, AVIO_FLAG_WRITE, NULL)) < 0)
+        goto end;
+
+    avio_wb32(pb, MXF_INDEX_CACHE_TAG);
+    avio_wb32(pb, MXF_INDEX_CACHE_VERSION);
+    avio_wb64(pb, file_size);
+    avio_wb32(pb, mxf->run_in);
+    avio_wb32(pb, key[0]);
+    avio_wb32(pb, key[1]);
+    avio_wb64(pb, mxf->footer_partition);
+    avio_wb32(pb, mxf->op);
+    avio_wb64(pb, essence_offset);
+
+    avio_wb32(pb, mxf->partitions_count);
+    for (int i = 0; i < mxf->partitions_count; i++) {
+        const MXFPartition *p = &mxf->partitions[i];
+        avio_w8  (pb, p->type);
+        avio_w8  (pb, p->closed);
+        avio_w8  (pb, p->complete);
+        avio_wb64(pb, p->previous_partition);
+        avio_wb32(pb, p->index_sid);
+        avio_wb32(pb, p->body_sid);
+        avio_wb32(pb, p->kag_size);
+        avio_wb64(pb, p->header_byte_count);
+        avio_wb64(pb, p->index_byte_count);
+        avio_wb32(pb, p->pack_length);
+        avio_wb64(pb, p->pack_ofs);
+        avio_wb64(pb, p->body_offset);
+        avio_write(pb, p->first_essence_klv.key, 16);
+        avio_wb64(pb, p->first_essence_klv.offset);
+        avio_wb64(pb, p->first_essence_klv.length);
+        avio_wb64(pb, p->first_essence_klv.next_klv);
+    }
+
+    avio_wb32(pb, mg->metadata_sets_count);
+    for (int i = 0; i < mg->metadata_sets_count; i++) {
+        const MXFIndexTableSegment *seg = (MXFIndexTableSegment *)mg->metadata_sets[i];
+        avio_write(pb, seg->meta.uid, 16);
+        avio_wb64(pb, seg->meta.partition_score);
+        avio_wb32(pb, seg->edit_unit_byte_count);
+        avio_wb32(pb, seg->index_sid);
+        avio_wb32(pb, seg->body_sid);
+        avio_wb32(pb, seg->index_edit_rate.num);
+        avio_wb32(pb, seg->index_edit_rate.den);
+        avio_wb64(pb, seg->index_start_position);
+        avio_wb64(pb, seg->index_duration);
+        avio_wb32(pb, seg->nb_index_entries);
+        for (int j = 0; j < seg->nb_index_entries; j++) {
+            avio_w8  (pb, seg->temporal_offset_entries[j]);
+            avio_w8  (pb, seg->flag_entries[j]);
+            avio_wb64(pb, seg->stream_offset_entries[j]);
+        }
+    }
+
+    avio_flush(pb);
+    ret = pb->error;
+    ff_format_io_close(s, &pb);
+    if (ret >= 0)
+        ret = ff_rename(tmp, mxf->index_cache, s);
+
+end:
+    if (ret < 0)
+        av_log(s, AV_LOG_WARNING, "could not write index cache %s\n", mxf->index_cache);
+    av_free(tmp);
+}
+
+static int mxf_read_index_cache_segments(AVIOContext *pb, MXFIndexTableSegment **segments,
+                                         int nb_segments)
+{
+    for (int i = 0; i < nb_segments; i++) {
+        MXFIndexTableSegment *seg;
+        uint32_t nb_index_entries;
+
+        if (avio_feof(pb))
+            return AVERROR_INVALIDDATA;
+        if (!(seg = segments[i] = av_mallocz(sizeof(*seg))))
+            return AVERROR(ENOMEM);
+        avio_read(pb, seg->meta.uid, 16);
+        seg->meta.partition_score     = avio_rb64(pb);
+        seg->edit_unit_byte_count     = avio_rb32(pb);
+        seg->index_sid                = avio_rb32(pb);
+        seg->body_sid                 = avio_rb32(pb);
+        seg->index_edit_rate.num      = avio_rb32(pb);
+        seg->index_edit_rate.den      = avio_rb32(pb);
+        seg->index_start_position     = avio_rb64(pb);
+        seg->index_duration           = avio_rb64(pb);
+        nb_index_entries              = avio_rb32(pb);
+
+        if (nb_index_entries > INT_MAX || nb_index_entries > avio_size(pb))
+            return AVERROR_INVALIDDATA;
+        seg->nb_index_entries = nb_index_entries;
+        if (!seg->nb_index_entries)
+            continue;
+
+        if (!FF_ALLOC_TYPED_ARRAY(seg->temporal_offset_entries, seg->nb_index_entries) ||
+            !FF_ALLOC_TYPED_ARRAY(seg->flag_entries           , seg->nb_index_entries) ||
+            !FF_ALLOC_TYPED_ARRAY(seg->stream_offset_entries  , seg->nb_index_entries))
+            return AVERROR(ENOMEM);
+        for (int j = 0; j < seg->nb_index_entries; j++) {
+            seg->temporal_offset_entries[j] = avio_r8(pb);
+            seg->flag_entries[j]            = avio_r8(pb);
+            seg->stream_offset_entries[j]   = avio_rb64(pb);
+        }
+    }
+    return avio_feof(pb) ? AVERROR_INVALIDDATA : 0;
+}
+
+/**
+ * Restores the partitions and index table segments from the sidecar cache
+ * and reads the header metadata of the partitions that carry it.
+ * @return 1 if the cache was used, 0 if it is missing or stale, <0 on error
+ */
+static int mxf_read_index_cache(AVFormatContext *s, int64_t *essence_offset)
+{
+    MXFContext *mxf = s->priv_data;
+    MXFMetadataSetGroup *mg = &mxf->metadata_set_groups[IndexTableSegment];
+    MXFPartition *partitions = NULL;
+    MXFIndexTableSegment **segments = NULL;
+    AVIOContext *pb = NULL;
+    unsigned partitions_count = 0, nb_segments = 0;
+    uint32_t cached_key[2], key[2];
+    uint64_t footer_partition;
+    int64_t file_size, cached_essence_offset;
+    KLVPacket klv;
+    MXFOP op;
+    int ret;
+
+    if (!(s->pb->seekable & AVIO_SEEKABLE_NORMAL))
+        return 0;
+    if (s->io_open(s, &pb, mxf->index_cache, AVIO_FLAG_READ, NULL) < 0)
+        return 0;
+
+    ret = AVERROR_INVALIDDATA;
+    if (avio_rb32(pb) != MXF_INDEX_CACHE_TAG ||
+        avio_rb32(pb) != MXF_INDEX_CACHE_VERSION)
+        goto fail;
+
+    file_size             = avio_rb64(pb);
+    if (file_size != avio_size(s->pb) || avio_rb32(pb) != mxf->run_in)
+        goto fail;
+    cached_key[0]         = avio_rb32(pb);
+    cached_key[1]         = avio_rb32(pb);
+    footer_partition      = avio_rb64(pb);
+    op                    = avio_rb32(pb);
+    cached_essence_offset = avio_rb64(pb);
+
+    partitions_count = avio_rb32(pb);
+    if (!partitions_count || partitions_count >= INT_MAX / 2 ||
+        partitions_count > avio_size(pb))
+        goto fail;
+    if (!(partitions = av_calloc(partitions_count, sizeof(*partitions)))) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (int i = 0; i < partitions_count; i++) {
+        MXFPartition *p = &partitions[i];
+        p->type                       = avio_r8(pb);
+        p->closed                     = avio_r8(pb);
+        p->complete                   = avio_r8(pb);
+        p->previous_partition         = avio_rb64(pb);
+        p->index_sid                  = avio_rb32(pb);
+        p->body_sid                   = avio_rb32(pb);
+        p->kag_size                   = avio_rb32(pb);
+        p->header_byte_count          = avio_rb64(pb);
+        p->index_byte_count           = avio_rb64(pb);
+        p->pack_length                = avio_rb32(pb);
+        p->pack_ofs                   = avio_rb64(pb);
+        p->body_offset                = avio_rb64(pb);
+        avio_read(pb, p->first_essence_klv.key, 16);
+        p->first_essence_klv.offset   = avio_rb64(pb);
+        p->first_essence_klv.length   = avio_rb64(pb);
+        p->first_essence_klv.next_klv = avio_rb64(pb);
+
+        if (p->pack_length <= 0 || p->pack_ofs < mxf->run_in ||
+            p->pack_ofs > file_size - p->pack_length ||
+            p->header_byte_count < 0 || p->header_byte_count > file_size)
+            goto fail;
+    }
+    if (partitions[0].type != Header || partitions[0].pack_ofs != mxf->run_in)
+        goto fail;
+
+    nb_segments = avio_rb32(pb);
+    if (nb_segments > INT_MAX || nb_segments > avio_size(pb))
+        goto fail;
+    if (nb_segments && !(segments = av_calloc(nb_segments, sizeof(*segments)))) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = mxf_read_index_cache_segments(pb, segments, nb_segments)) < 0)
+        goto fail;
+
+    /* the cache is only valid for the exact file it was built from */
+    ret = mxf_index_cache_key(mxf, partitions, partitions_count, key);
+    if (ret < 0 || key[0] != cached_key[0] || key[1] != cached_key[1]) {
+        ret = AVERROR_INVALIDDATA;
+        goto fail;
+    }
+    ff_format_io_close(s, &pb);
+
+    /* parse the header partition pack for the side effects on the context,
+     * then replace the partition list with the cached one */
+    avio_seek(s->pb, mxf->run_in, SEEK_SET);
+    if ((ret = klv_read_packet(mxf, &klv, s->pb)) < 0 ||
+        (ret = mxf_parse_klv(mxf, klv, mxf_read_partition_pack, 0, 0)) < 0)
+        goto fail;
+
+    av_free(mxf->partitions);
+    mxf->partitions        = partitions;
+    mxf->partitions_count  = partitions_count;
+    mxf->footer_partition  = footer_partition;
+    mxf->op                = op;
+    mxf->current_partition = &mxf->partitions[0];
+    partitions = NULL;
+
+    for (int i = 0; i < nb_segments; i++) {
+        ret = av_dynarray_add_nofree(&mg->metadata_sets, &mg->metadata_sets_count, segments[i]);
+        if (ret < 0)
+            goto fail;
+        segments[i] = NULL;
+    }
+    av_freep(&segments);
+
+    for (int i = 0; i < mxf->partitions_count; i++) {
+        MXFPartition *p = &mxf->partitions[i];
+        int64_t end = file_size;
+        int primer = 0;
+
+        if (i + 1 < mxf->partitions_count && mxf->partitions[i + 1].pack_ofs > p->pack_ofs)
+            end = mxf->partitions[i + 1].pack_ofs;
+
+        if (!p->header_byte_count)
+            continue;
+
+        mxf->current_partition = p;
+        avio_seek(s->pb, p->pack_ofs + p->pack_length, SEEK_SET);
+        while (avio_tell(s->pb) < end && !avio_feof(s->pb)) {
+            if ((ret = klv_read_packet(mxf, &klv, s->pb)) < 0)
+                goto fail;
+            /* HeaderByteCount starts at the primer pack, not counting
+             * any fill after the partition pack */
+            if (!primer && IS_KLV_KEY(klv.key, mxf_primer_pack_key)) {
+                end = FFMIN(end, klv.offset + p->header_byte_count);
+                primer = 1;
+            }
+            if (klv.offset >= end)
+                break;
+            if ((ret = mxf_read_metadata_klv(mxf, klv)) < 0)
+                goto fail;
+        }
+    }
+
+    av_log(s, AV_LOG_VERBOSE, "using index cache %s\n", mxf->index_cache);
+    *essence_offset = cached_essence_offset;
+    return 1;
+
+fail:
+    ff_format_io_close(s, &pb);
+    av_free(partitions);
+    for (int i = 0; i < nb_segments && segments; i++)
+        if (segments[i])
+            mxf_free_metadataset((MXFMetadataSet **)&segments[i], IndexTableSegment);
+    av_free(segments);
+    if (ret == AVERROR(ENOMEM) || mxf->partitions_count)
+        return ret;
+    av_log(s, AV_LOG_VERBOSE, "ignoring stale index cache %s\n", mxf->index_cache);
+    avio_seek(s->pb, mxf->run_in, SEEK_SET);
+    return 0;
+}
+
 static int mxf_read_header(AVFormatContext *s)
 {
     MXFContext *mxf = s->priv_data;
     KLVPacket klv;
     int64_t essence_offset = 0;
-    int ret;
+    int ret, cached = 0;
     int64_t run_in;
 
     mxf->last_forward_tell = INT64_MAX;
@@ -3800,9 +4261,10 @@ static int mxf_read_header(AVFormatContext *s)
 
     mxf_read_random_index_pack(s);
 
-    while (!avio_feof(s->pb)) {
-        size_t x;
+    if (mxf->index_cache && (cached = mxf_read_index_cache(s, &essence_offset)) < 0)
+        return cached;
 
+    while (!cached && !avio_feof(s->pb)) {
         ret = klv_read_packet(mxf, &klv, s->pb);
         if (ret < 0 || IS_KLV_KEY(klv.key, ff_mxf_random_index_pack_key)) {
             if (ret >= 0 && avio_size(s->pb) > klv.next_klv)
@@ -3847,24 +4309,13 @@ static int mxf_read_header(AVFormatContext *s)
             /* we're still parsing forward. proceed to parsing this partition pack */
         }
 
-        for (x = 0; x < FF_ARRAY_ELEMS(mxf_metadata_read_table); x++) {
-            const MXFMetadataReadTableEntry *metadata = &mxf_metadata_read_table[x];
-            if (IS_KLV_KEY(klv.key, metadata->key)) {
-                if (metadata->read) {
-                    if ((ret = mxf_parse_klv(mxf, klv, metadata->read, metadata->ctx_size, metadata->type)) < 0)
-                        return ret;
-                } else {
-                    avio_skip(s->pb, klv.length);
-                }
-                break;
-            }
-        }
-        if (x >= FF_ARRAY_ELEMS(mxf_metadata_read_table)) {
-            av_log(s, AV_LOG_VERBOSE, "Dark key " PRIxUID "\n",
-                            UID_ARG(klv.key));
-            avio_skip(s->pb, klv.length);
-        }
+        if ((ret = mxf_read_metadata_klv(mxf, klv)) < 0)
+            return ret;
     }
+
+    if (!cached && mxf->index_cache)
+        mxf_write_index_cache(s, essence_offset);
+
     /* FIXME avoid seek */
     if (!essence_offset)  {
         av_log(s, AV_LOG_ERROR, "no essence\n");
@@ -3897,6 +4348,16 @@ static int mxf_read_header(AVFormatContext *s)
     for (int i = 0; i < s->nb_streams; i++)
         mxf_compute_edit_units_per_packet(mxf, s->streams[i]);
 
+    if (mxf_following(mxf)) {
+        if (!(s->pb->seekable & AVIO_SEEKABLE_NORMAL)) {
+            av_log(s, AV_LOG_WARNING, "input is not seekable, not following it\n");
+            mxf->follow = 0;
+        } else {
+            mxf->follow_pos  = essence_offset;
+            mxf->follow_size = avio_size(s->pb);
+        }
+    }
+
     return 0;
 }
 
@@ -3970,7 +4431,9 @@ static int64_t mxf_set_current_edit_unit(MXFContext *mxf, AVStream *st, int64_t
 
     if (mxf_edit_unit_absolute_offset(mxf, t, edit_unit + track->edit_units_per_packet, track->edit_rate, NULL, &next_ofs, NULL, 0) < 0 &&
         (next_ofs = mxf_essence_container_end(mxf, t->body_sid)) <= 0) {
-        av_log(mxf->fc, AV_LOG_ERROR, "unable to compute the size of the last packet\n");
+        /* the index of a growing file does not cover its last partition yet */
+        if (!mxf_following(mxf))
+            av_log(mxf->fc, AV_LOG_ERROR, "unable to compute the size of the last packet\n");
         return -1;
     }
 
@@ -4047,6 +4510,181 @@ static int mxf_set_pts(MXFContext *mxf, AVStream *st, AVPacket *pkt)
     return 0;
 }
 
+static void mxf_free_index_tables(MXFContext *mxf)
+{
+    for (int i = 0; i < mxf->nb_index_tables; i++) {
+        av_freep(&mxf->index_tables[i].segments);
+        av_freep(&mxf->index_tables[i].ptses);
+        av_freep(&mxf->index_tables[i].fake_index);
+        av_freep(&mxf->index_tables[i].offsets);
+        av_freep(&mxf->index_tables[i].flags);
+    }
+    av_freep(&mxf->index_tables);
+    mxf->nb_index_tables = 0;
+}
+
+/**
+ * Appends an index table segment read from a growing file to its index table.
+ * @return 1 if the segment was appended or ignored, 0 if the index tables must
+ *         be rebuilt, <0 on error
+ */
+static int mxf_append_index_table_segment(MXFContext *mxf, MXFIndexTableSegment *segment)
+{
+    MXFIndexTable *t = mxf_find_index_table(mxf, segment->index_sid);
+    MXFIndexTableSegment *last, **segments;
+    int ret;
+
+    if (!segment->edit_unit_byte_count && !segment->nb_index_entries) {
+        av_log(mxf->fc, AV_LOG_WARNING, "IndexSID %i segment at %"PRId64" missing EditUnitByteCount and IndexEntryArray\n",
+               segment->index_sid, segment->index_start_position);
+        return 1;
+    }
+
+    /* new IndexSIDs, duplicates, segments out of order and zero IndexDurations
+     * are left to mxf_compute_index_tables() */
+    if (!t || !t->nb_segments)
+        return 0;
+    last = t->segments[t->nb_segments - 1];
+    if (segment->body_sid != t->body_sid || !segment->index_duration || !last->index_duration ||
+        segment->index_start_position < last->index_start_position ||
+        segment->index_start_position - last->index_start_position < last->index_duration)
+        return 0;
+
+    if (!segment->index_edit_rate.num || !segment->index_edit_rate.den) {
+        av_log(mxf->fc, AV_LOG_WARNING, "IndexSID %i segment %i has invalid IndexEditRate\n",
+               t->index_sid, t->nb_segments);
+        for (int k = 0; k < mxf->fc->nb_streams; k++) {
+            MXFTrack *track = mxf->fc->streams[k]->priv_data;
+            if (track && track->index_sid == t->index_sid) {
+                segment->index_edit_rate = track->edit_rate;
+                break;
+            }
+        }
+    }
+
+    /* EditUnitByteCount == 0 for VBR indexes, which is fine since they use explicit StreamOffsets */
+    segment->offset = last->offset + last->edit_unit_byte_count * last->index_duration;
+    if (segment->edit_unit_byte_count && (segment->index_duration > INT64_MAX / segment->edit_unit_byte_count ||
+        segment->edit_unit_byte_count * segment->index_duration > INT64_MAX - segment->offset))
+        return AVERROR_INVALIDDATA;
+
+    segments = av_realloc_array(t->segments, t->nb_segments + 1, sizeof(*t->segments));
+    if (!segments)
+        return AVERROR(ENOMEM);
+    t->segments = segments;
+    t->segments[t->nb_segments++] = segment;
+
+    if ((ret = mxf_extend_ptses_fake_index(mxf, t)) < 0)
+        return ret;
+
+    return 1;
+}
+
+/**
+ * Adds an index table segment found in a growing file to the index tables,
+ * and extends the stream durations to the end of the index.
+ */
+static int mxf_follow_update_index(AVFormatContext *s, MXFIndexTableSegment *segment)
+{
+    MXFContext *mxf = s->priv_data;
+    int ret;
+
+    if ((ret = mxf_append_index_table_segment(mxf, segment)) < 0)
+        return ret;
+    if (!ret) {
+        mxf_free_index_tables(mxf);
+        if ((ret = mxf_compute_index_tables(mxf)) < 0)
+            return ret;
+    }
+
+    for (int i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        MXFTrack *track = st->priv_data;
+        MXFIndexTable *t;
+        MXFIndexTableSegment *last;
+        int64_t duration;
+
+        if (!track || !(t = mxf_find_index_table(mxf, track->index_sid)))
+            continue;
+
+        last = t->segments[t->nb_segments - 1];
+        if (last->index_duration > INT64_MAX - last->index_start_position)
+            continue;
+        duration = av_rescale_q(last->index_start_position + last->index_duration,
+                                t->segments[0]->index_edit_rate, track->edit_rate);
+        if (duration <= track->original_duration)
+            continue;
+
+        track->original_duration = duration;
+        st->duration = av_rescale_q(duration, av_inv_q(track->edit_rate), st->time_base);
+        mxf_compute_edit_units_per_packet(mxf, st);
+    }
+
+    return 0;
+}
+
+/**
+ * Parses the partition packs and index table segments written to a growing
+ * file after the header was read.
+ * @return >0 if the KLV was consumed, 0 if it should be skipped, <0 on error
+ */
+static int mxf_follow_read_klv(AVFormatContext *s, KLVPacket *klv)
+{
+    MXFContext *mxf = s->priv_data;
+    int ret;
+
+    if (klv->offset < mxf->follow_pos)
+        return 0;
+
+    if (mxf_is_partition_pack_key(klv->key)) {
+        if ((ret = mxf_parse_klv(mxf, *klv, mxf_read_partition_pack, 0, 0)) < 0)
+            return ret;
+        av_log(s, AV_LOG_VERBOSE, "found partition @ %#"PRIx64"\n", klv->offset);
+        mxf_compute_essence_containers(s);
+    } else if (IS_KLV_KEY(klv->key, mxf_index_table_segment_key)) {
+        MXFMetadataSetGroup *mg = &mxf->metadata_set_groups[IndexTableSegment];
+        int nb_segments = mg->metadata_sets_count;
+
+        if ((ret = mxf_read_metadata_klv(mxf, *klv)) < 0)
+            return ret;
+        if (mg->metadata_sets_count > nb_segments &&
+            (ret = mxf_follow_update_index(s, (MXFIndexTableSegment *)mg->metadata_sets[nb_segments])) < 0)
+            return ret;
+    } else {
+        return 0;
+    }
+
+    mxf->follow_pos = klv->next_klv;
+    avio_seek(s->pb, klv->next_klv, SEEK_SET);
+    return 1;
+}
+
+/**
+ * Waits for a growing file to get larger.
+ * @return 1 once it did, with pb at pos, AVERROR_EOF on timeout, <0 on error
+ */
+static int mxf_follow_wait(AVFormatContext *s, int64_t pos)
+{
+    MXFContext *mxf = s->priv_data;
+    int64_t start = av_gettime_relative();
+    int64_t size, ret;
+
+    while ((size = avio_size(s->pb)) <= mxf->follow_size) {
+        if (size < 0)
+            return size;
+        if (ff_check_interrupt(&s->interrupt_callback))
+            return AVERROR_EXIT;
+        if (mxf->follow_timeout >= 0 && av_gettime_relative() - start > mxf->follow_timeout)
+            return AVERROR_EOF;
+        av_usleep(MXF_FOLLOW_POLL_US);
+    }
+
+    mxf->follow_size = size;
+    if ((ret = avio_seek(s->pb, pos, SEEK_SET)) < 0)
+        return ret;
+    return 1;
+}
+
 static int mxf_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     KLVPacket klv;
@@ -4060,6 +4698,15 @@ static int mxf_read_packet(AVFormatContext *s, AVPacket *pkt)
         if (pos < mxf->current_klv_data.next_klv - mxf->current_klv_data.length || pos >= mxf->current_klv_data.next_klv) {
             mxf->current_klv_data = (KLVPacket){{0}};
             ret = klv_read_packet(mxf, &klv, s->pb);
+            if (mxf_following(mxf)) {
+                /* wait for the end of the file or of a partially written KLV,
+                 * the length of which reads as zeroes if cut short */
+                if (ret >= 0 && klv.next_klv > mxf->follow_size)
+                    mxf->follow_size = avio_size(s->pb);
+                if ((ret < 0 || s->pb->eof_reached || klv.next_klv > mxf->follow_size) &&
+                    (ret = mxf_follow_wait(s, pos)) > 0)
+                    continue;
+            }
             if (ret < 0)
                 break;
             // klv.key[0..3] == mxf_klv_key from here forward
@@ -4098,6 +4745,14 @@ static int mxf_read_packet(AVFormatContext *s, AVPacket *pkt)
             st = s->streams[index];
             track = st->priv_data;
 
+            if (mxf_following(mxf) && klv.offset >= mxf->follow_pos) {
+                MXFPartition *p = &mxf->partitions[mxf->partitions_count - 1];
+                if (!p->first_essence_klv.offset) {
+                    p->first_essence_klv = klv;
+                    mxf_compute_essence_containers(s);
+                }
+            }
+
             if (s->streams[index]->discard == AVDISCARD_ALL)
                 goto skip;
 
@@ -4167,6 +4822,11 @@ static int mxf_read_packet(AVFormatContext *s, AVPacket *pkt)
 
             return 0;
         } else {
+            if (mxf_following(mxf) && (ret = mxf_follow_read_klv(s, &klv))) {
+                if (ret < 0)
+                    return ret;
+                continue;
+            }
         skip:
             avio_skip(s->pb, max_data_size);
             mxf->current_klv_data = (KLVPacket){{0}};
@@ -4196,15 +4856,7 @@ static int mxf_read_close(AVFormatContext *s)
     av_freep(&mxf->aesc);
     av_freep(&mxf->local_tags);
 
-    if (mxf->index_tables) {
-        for (int i = 0; i < mxf->nb_index_tables; i++) {
-            av_freep(&mxf->index_tables[i].segments);
-            av_freep(&mxf->index_tables[i].ptses);
-            av_freep(&mxf->index_tables[i].fake_index);
-            av_freep(&mxf->index_tables[i].offsets);
-        }
-    }
-    av_freep(&mxf->index_tables);
+    mxf_free_index_tables(mxf);
 
     return 0;
 }
@@ -4351,6 +5003,15 @@ static const AVOption options[] = {
     { "eia608_extract", "extract eia 608 captions from s436m track",
       offsetof(MXFContext, eia608_extract), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1,
       AV_OPT_FLAG_DECODING_PARAM },
+    { "index_cache", "sidecar file caching partitions and index table segments",
+      offsetof(MXFContext, index_cache), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0,
+      AV_OPT_FLAG_DECODING_PARAM },
+    { "growing", "follow a file that is still being written",
+      offsetof(MXFContext, follow), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1,
+      AV_OPT_FLAG_DECODING_PARAM },
+    { "growing_timeout", "stop following the file when it has not grown for this long, -1 to wait forever",
+      offsetof(MXFContext, follow_timeout), AV_OPT_TYPE_DURATION, {.i64 = 10000000}, -1, INT64_MAX,
+      AV_OPT_FLAG_DECODING_PARAM },
     { NULL },
 };
 
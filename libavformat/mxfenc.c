@@ -492,6 +492,8 @@ typedef struct MXFContext {
     int cbr_index;           ///< use a constant bitrate index
     uint8_t unused_tags[MXF_NUM_TAGS];  ///< local tags that we know will not be used
     MXFStreamContext timecode_track_priv;
+    uint8_t *d10_audio_buf;  ///< AES3 element being built
+    unsigned d10_audio_buf_size;
 } MXFContext;
 
 static void mxf_write_uuid(AVIOContext *pb, enum MXFMetadataSetType type, int value)
@@ -2108,6 +2110,8 @@ static int mxf_write_index_table_segment(AVFormatContext *s)
 
     if (!mxf->edit_unit_byte_count) {
         MXFStreamContext *sc = s->streams[0]->priv_data;
+        uint8_t entries[64 * 15], *p = entries;
+
         mxf_write_local_tag(s, 8 + mxf->edit_units_count*15, 0x3F0A);
         avio_wb32(pb, mxf->edit_units_count);  // num of entries
         avio_wb32(pb, 15);  // size of one entry
@@ -2115,6 +2119,11 @@ static int mxf_write_index_table_segment(AVFormatContext *s)
         for (i = 0; i < mxf->edit_units_count; i++) {
             int temporal_offset = 0;
 
+            if (p == entries + sizeof(entries)) {
+                avio_write(pb, entries, sizeof(entries));
+                p = entries;
+            }
+
             if (!(mxf->index_entries[i].flags & 0x33)) { // I-frame
                 sc->max_gop = FFMAX(sc->max_gop, i - mxf->last_key_index);
                 mxf->last_key_index = key_index;
@@ -2136,7 +2145,7 @@ static int mxf_write_index_table_segment(AVFormatContext *s)
                         return err;
                 }
             }
-            avio_w8(pb, temporal_offset);
+            bytestream_put_byte(&p, temporal_offset);
 
             if ((mxf->index_entries[i].flags & 0x30) == 0x30) { // back and forward prediction
                 int offset = mxf->last_key_index - i;
@@ -2144,13 +2153,13 @@ static int mxf_write_index_table_segment(AVFormatContext *s)
                 if (err < 0)
                     return err;
                 sc->b_picture_count = FFMAX(sc->b_picture_count, i - prev_non_b_picture);
-                avio_w8(pb, offset);
+                bytestream_put_byte(&p, offset);
             } else {
                 int offset = key_index - i;
                 err = mxf_check_frame_offset(s, offset);
                 if (err < 0)
                     return err;
-                avio_w8(pb, offset); // key frame offset
+                bytestream_put_byte(&p, offset); // key frame offset
                 if ((mxf->index_entries[i].flags & 0x20) == 0x20) // only forward
                     mxf->last_key_index = key_index;
                 prev_non_b_picture = i;
@@ -2159,14 +2168,15 @@ static int mxf_write_index_table_segment(AVFormatContext *s)
             if (!(mxf->index_entries[i].flags & 0x33) && // I-frame
                 mxf->index_entries[i].flags & 0x40 && !temporal_offset)
                 mxf->index_entries[i].flags |= 0x80; // random access
-            avio_w8(pb, mxf->index_entries[i].flags);
+            bytestream_put_byte(&p, mxf->index_entries[i].flags);
             // stream offset
-            avio_wb64(pb, mxf->index_entries[i].offset);
+            bytestream_put_be64(&p, mxf->index_entries[i].offset);
             if (s->nb_streams > 1)
-                avio_wb32(pb, mxf->index_entries[i].slice_offset);
+                bytestream_put_be32(&p, mxf->index_entries[i].slice_offset);
             else
-                avio_wb32(pb, 0);
+                bytestream_put_be32(&p, 0);
         }
+        avio_write(pb, entries, p - entries);
 
         mxf->last_key_index = key_index - mxf->edit_units_count;
         mxf->last_indexed_edit_unit += mxf->edit_units_count;
@@ -2190,6 +2200,29 @@ static void mxf_write_klv_fill(AVFormatContext *s)
     }
 }
 
+/**
+ * Write the KLV fill aligning the next element to the KAG, and the key and
+ * 4-byte length of that element, in a single write.
+ */
+static void mxf_write_element_header(AVIOContext *pb, const uint8_t *key, int len)
+{
+    uint8_t buf[2 * KAG_SIZE], *p = buf;
+    unsigned pad = klv_fill_size(avio_tell(pb));
+
+    if (pad) {
+        bytestream_put_buffer(&p, klv_fill_key, 16);
+        pad -= 16 + 4;
+        bytestream_put_byte(&p, 0x80 + 3);
+        bytestream_put_be24(&p, pad);
+        memset(p, 0, pad);
+        p += pad;
+    }
+    bytestream_put_buffer(&p, key, 16);
+    bytestream_put_byte(&p, 0x80 + 3);
+    bytestream_put_be24(&p, len);
+    avio_write(pb, buf, p - buf);
+}
+
 static int mxf_write_partition(AVFormatContext *s, int bodysid,
                                 int indexsid,
                                 const uint8_t *key, int write_metadata)
@@ -3048,6 +3081,11 @@ static int mxf_init(AVFormatContext *s)
                 if (st->codecpar->codec_id != AV_CODEC_ID_PCM_S16LE &&
                     st->codecpar->codec_id != AV_CODEC_ID_PCM_S24LE) {
                     av_log(s, AV_LOG_ERROR, "MXF D-10 only support 16 or 24 bits le audio\n");
+                    return AVERROR_PATCHWELCOME;
+                }
+                if (st->codecpar->ch_layout.nb_channels > 8) {
+                    av_log(s, AV_LOG_ERROR, "MXF D-10 only supports up to 8 audio channels\n");
+                    return AVERROR(EINVAL);
                 }
                 sc->index = INDEX_D10_AUDIO;
                 sc->container_ul = ((MXFStreamContext*)s->streams[0]->priv_data)->container_ul;
@@ -3172,7 +3210,7 @@ static const uint8_t system_metadata_package_set_key[] = { 0x06,0x0E,0x2B,0x34,0
 static void mxf_write_system_item(AVFormatContext *s)
 {
     MXFContext *mxf = s->priv_data;
-    AVIOContext *pb = s->pb;
+    uint8_t buf[57 + 16 + 4 + 35], *p = buf;
     unsigned frame;
     uint32_t time_code;
     int i, system_item_bitmap = 0x58; // UL, user date/time stamp, picture present
@@ -3180,8 +3218,7 @@ static void mxf_write_system_item(AVFormatContext *s)
     frame = mxf->last_indexed_edit_unit + mxf->edit_units_count;
 
     // write system metadata pack
-    avio_write(pb, system_metadata_pack_key, 16);
-    klv_encode_ber4_length(pb, 57);
+    mxf_write_element_header(s->pb, system_metadata_pack_key, 57);
 
     for (i = 0; i < s->nb_streams; i++) {
         if (s->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
@@ -3190,49 +3227,61 @@ static void mxf_write_system_item(AVFormatContext *s)
                  s->streams[i]->codecpar->codec_id == AV_CODEC_ID_EIA_608)
             system_item_bitmap |= 0x2;
     }
-    avio_w8(pb, system_item_bitmap);
-    avio_w8(pb, mxf->content_package_rate); // content package rate
-    avio_w8(pb, 0x00); // content package type
-    avio_wb16(pb, 0x00); // channel handle
-    avio_wb16(pb, frame & 0xFFFF); // continuity count, supposed to overflow
+    bytestream_put_byte(&p, system_item_bitmap);
+    bytestream_put_byte(&p, mxf->content_package_rate); // content package rate
+    bytestream_put_byte(&p, 0x00); // content package type
+    bytestream_put_be16(&p, 0x00); // channel handle
+    bytestream_put_be16(&p, frame & 0xFFFF); // continuity count, supposed to overflow
     if (mxf->essence_container_count > 1)
-        avio_write(pb, multiple_desc_ul, 16);
+        bytestream_put_buffer(&p, multiple_desc_ul, 16);
     else {
         MXFStreamContext *sc = s->streams[0]->priv_data;
-        avio_write(pb, *sc->container_ul, 16);
+        bytestream_put_buffer(&p, *sc->container_ul, 16);
     }
-    avio_w8(pb, 0);
-    avio_wb64(pb, 0);
-    avio_wb64(pb, 0); // creation date/time stamp
+    bytestream_put_byte(&p, 0);
+    bytestream_put_be64(&p, 0);
+    bytestream_put_be64(&p, 0); // creation date/time stamp
 
-    avio_w8(pb, 0x81); // SMPTE 12M time code
+    bytestream_put_byte(&p, 0x81); // SMPTE 12M time code
     time_code = av_timecode_get_smpte_from_framenum(&mxf->tc, frame);
-    avio_wb32(pb, time_code);
-    avio_wb32(pb, 0); // binary group data
-    avio_wb64(pb, 0);
+    bytestream_put_be32(&p, time_code);
+    bytestream_put_be32(&p, 0); // binary group data
+    bytestream_put_be64(&p, 0);
 
     // write system metadata package set
-    avio_write(pb, system_metadata_package_set_key, 16);
-    klv_encode_ber4_length(pb, 35);
-    avio_w8(pb, 0x83); // UMID
-    avio_wb16(pb, 0x20);
-    mxf_write_umid(s, 1);
+    bytestream_put_buffer(&p, system_metadata_package_set_key, 16);
+    bytestream_put_byte(&p, 0x80 + 3);
+    bytestream_put_be24(&p, 35);
+    bytestream_put_byte(&p, 0x83); // UMID
+    bytestream_put_be16(&p, 0x20);
+    bytestream_put_buffer(&p, umid_ul, 13);
+    bytestream_put_be24(&p, mxf->instance_number);
+    bytestream_put_buffer(&p, mxf->umid, 15);
+    bytestream_put_byte(&p, 1);
+
+    av_assert1(p == buf + sizeof(buf));
+    avio_write(s->pb, buf, sizeof(buf));
 }
 
-static void mxf_write_d10_audio_packet(AVFormatContext *s, AVStream *st, AVPacket *pkt)
+static int mxf_write_d10_audio_packet(AVFormatContext *s, AVStream *st, AVPacket *pkt)
 {
     MXFContext *mxf = s->priv_data;
-    AVIOContext *pb = s->pb;
+    MXFStreamContext *sc = st->priv_data;
     int frame_size = pkt->size / st->codecpar->block_align;
+    int size = 4 + frame_size*4*8;
     const uint8_t *samples = pkt->data;
-    const uint8_t *const end = pkt->data + pkt->size;
+    const uint8_t *const end = pkt->data + frame_size * st->codecpar->block_align;
+    uint8_t *p;
     int i;
 
-    klv_encode_ber4_length(pb, 4 + frame_size*4*8);
+    av_fast_malloc(&mxf->d10_audio_buf, &mxf->d10_audio_buf_size, size);
+    if (!mxf->d10_audio_buf)
+        return AVERROR(ENOMEM);
+    p = mxf->d10_audio_buf;
 
-    avio_w8(pb, (frame_size == 1920 ? 0 : (mxf->edit_units_count-1) % 5 + 1));
-    avio_wl16(pb, frame_size);
-    avio_w8(pb, (1 << st->codecpar->ch_layout.nb_channels)-1);
+    bytestream_put_byte(&p, (frame_size == 1920 ? 0 : (mxf->edit_units_count-1) % 5 + 1));
+    bytestream_put_le16(&p, frame_size);
+    bytestream_put_byte(&p, (1 << st->codecpar->ch_layout.nb_channels)-1);
 
     while (samples < end) {
         for (i = 0; i < st->codecpar->ch_layout.nb_channels; i++) {
@@ -3244,11 +3293,15 @@ static void mxf_write_d10_audio_packet(AVFormatContext *s, AVStream *st, AVPacke
                 sample = AV_RL16(samples)<<12;
                 samples += 2;
             }
-            avio_wl32(pb, sample | i);
+            bytestream_put_le32(&p, sample | i);
         }
         for (; i < 8; i++)
-            avio_wl32(pb, i);
+            bytestream_put_le32(&p, i);
     }
+
+    mxf_write_element_header(s->pb, sc->track_essence_element_key, size);
+    avio_write(s->pb, mxf->d10_audio_buf, size);
+    return 0;
 }
 
 static int mxf_write_opatom_body_partition(AVFormatContext *s)
@@ -3425,7 +3478,6 @@ static int mxf_write_packet(AVFormatContext *s, AVPacket *pkt)
                 return err;
         }
 
-        mxf_write_klv_fill(s);
         mxf_write_system_item(s);
 
         if (!mxf->edit_unit_byte_count) {
@@ -3444,12 +3496,11 @@ static int mxf_write_packet(AVFormatContext *s, AVPacket *pkt)
             mxf->body_offset - mxf->index_entries[mxf->edit_units_count-1].offset;
     }
 
-    mxf_write_klv_fill(s);
-    avio_write(pb, sc->track_essence_element_key, 16); // write key
     if (IS_D10(s) && st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
-        mxf_write_d10_audio_packet(s, st, pkt);
+        if ((err = mxf_write_d10_audio_packet(s, st, pkt)) < 0)
+            return err;
     } else {
-        klv_encode_ber4_length(pb, pkt->size); // write length
+        mxf_write_element_header(pb, sc->track_essence_element_key, pkt->size);
         avio_write(pb, pkt->data, pkt->size);
         mxf->body_offset += 16+4+pkt->size + klv_fill_size(16+4+pkt->size);
     }
@@ -3552,6 +3603,7 @@ static void mxf_deinit(AVFormatContext *s)
     av_freep(&mxf->index_entries);
     av_freep(&mxf->body_partition_offset);
     av_freep(&mxf->timecode_track);
+    av_freep(&mxf->d10_audio_buf);
 }
 
 static int mxf_interleave_get_packet(AVFormatContext *s, AVPacket *out, int flush)
@@ -3559,8 +3611,14 @@ static int mxf_interleave_get_packet(AVFormatContext *s, AVPacket *out, int flus
     FFFormatContext *const si = ffformatcontext(s);
     int i, stream_count = 0;
 
-    for (i = 0; i < s->nb_streams; i++)
-        stream_count += !!ffstream(s->streams[i])->last_in_packet_buffer;
+    /* streams are usually filled in order for each edit unit, so looking
+     * from the last one finds a missing packet right away */
+    for (i = s->nb_streams - 1; i >= 0; i--) {
+        if (ffstream(s->streams[i])->last_in_packet_buffer)
+            stream_count++;
+        else if (!flush)
+            return 0;
+    }
 
     if (stream_count && (s->nb_streams == stream_count || flush)) {
         PacketListEntry *pktl = si->packet_buffer.head;
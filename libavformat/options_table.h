@@ -111,6 +111,7 @@ static const AVOption avformat_options[] = {
 {"max_probe_packets", "Maximum number of packets to probe a codec", OFFSET(max_probe_packets), AV_OPT_TYPE_INT, { .i64 = 2500 }, 0, INT_MAX, D },
 {"duration_probesize", "Maximum number of bytes to probe the durations of the streams in estimate_timings_from_pts", OFFSET(duration_probesize), AV_OPT_TYPE_INT64, {.i64 = 0 }, 0, (double)INT64_MAX, D},
 {"recursion_limit", "Maximum number of times a demuxer can recursively be opened", OFFSET(recursion_limit), AV_OPT_TYPE_INT, {.i64 = 10 }, 0, INT_MAX, D},
+{"stream_info_cache", "file caching the stream parameters found by probing", OFFSET(stream_info_cache), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, D},
 {NULL},
 };
 
@@ -0,0 +1,437 @@
+/*
+ * Background writer for segmenting muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libavutil/avstring.h"
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+#include "avio_internal.h"
+#include "internal.h"
+#include "segwriter.h"
+
+typedef struct SegmentWriterFile {
+    AVIOContext *pb;        ///< memory buffer while the file is open
+    char *url;
+    const char *path;       ///< url without the crypto: prefix
+    char *name;             ///< path of the file once written, after renames
+    AVDictionary *options;
+    uint8_t *data;
+    int size;
+    int flags;
+    int running;
+    struct SegmentWriterFile *next;
+} SegmentWriterFile;
+
+struct SegmentWriter {
+    AVFormatContext *s;
+
+    /* files between open and close, only accessed by the muxer thread */
+    SegmentWriterFile *open;
+
+    AVMutex lock;
+    AVCond  work_cond;      ///< signalled when a file becomes writable
+    AVCond  done_cond;      ///< signalled when a file has been written
+    SegmentWriterFile *pending;
+    SegmentWriterFile **pending_tail;
+    int nb_pending;
+    int max_pending;
+    int error;
+    int quit;
+
+#if HAVE_THREADS
+    pthread_t *threads;
+    int nb_threads;
+#endif
+};
+
+static void free_file(SegmentWriterFile **pf)
+{
+    SegmentWriterFile *f = *pf;
+
+    if (!f)
+        return;
+    ffio_free_dyn_buf(&f->pb);
+    av_freep(&f->url);
+    av_freep(&f->name);
+    av_dict_free(&f->options);
+    av_freep(&f->data);
+    av_freep(pf);
+}
+
+#if HAVE_THREADS
+static int write_file(SegmentWriter *w, SegmentWriterFile *f)
+{
+    AVFormatContext *s = w->s;
+    int ret;
+
+    /* Like the muxers do for synchronous uploads, retry once with a new
+     * connection if the upload fails after the file could be opened. */
+    for (int attempt = 0; ; attempt++) {
+        AVDictionary *options = NULL;
+        AVIOContext *pb = NULL;
+
+        ret = av_dict_copy(&options, f->options, 0);
+        if (ret >= 0)
+            ret = s->io_open(s, &pb, f->url, AVIO_FLAG_WRITE, &options);
+        av_dict_free(&options);
+        if (ret < 0)
+            break;
+        avio_write(pb, f->data, f->size);
+        ret = ff_format_io_close(s, &pb);
+        if (ret >= 0 || attempt)
+            break;
+        av_log(s, AV_LOG_WARNING, "Writing '%s' failed, retrying\n", f->url);
+    }
+    if (ret < 0)
+        av_log(s, AV_LOG_ERROR, "Failed to write '%s': %s\n",
+               f->url, av_err2str(ret));
+    return ret;
+}
+
+/* Ordered files wait until all files closed before them are written. */
+static SegmentWriterFile *next_file(SegmentWriter *w)
+{
+    for (SegmentWriterFile *f = w->pending; f; f = f->next) {
+        if (f->running)
+            continue;
+        if (!(f->flags & FF_SEGMENT_WRITE_ORDERED) || f == w->pending)
+            return f;
+    }
+    return NULL;
+}
+
+static void *worker_thread(void *arg)
+{
+    SegmentWriter *w = arg;
+
+    ff_thread_setname("segwriter");
+
+    ff_mutex_lock(&w->lock);
+    while (1) {
+        SegmentWriterFile *f = next_file(w), **pf;
+        int ret;
+
+        if (!f) {
+            if (w->quit && !w->pending)
+                break;
+            ff_cond_wait(&w->work_cond, &w->lock);
+            continue;
+        }
+
+        f->running = 1;
+        ff_mutex_unlock(&w->lock);
+        ret = write_file(w, f);
+        ff_mutex_lock(&w->lock);
+
+        /* Renames may have been requested while the file was written,
+         * they are done under the lock so that none is missed. */
+        if (ret >= 0 && strcmp(f->path, f->name))
+            ret = ff_rename(f->path, f->name, w->s);
+        if (ret < 0 && !w->error)
+            w->error = ret;
+
+        for (pf = &w->pending; *pf != f; pf = &(*pf)->next)
+            ;
+        *pf = f->next;
+        if (!*pf)
+            w->pending_tail = pf;
+        w->nb_pending--;
+        free_file(&f);
+
+        ff_cond_broadcast(&w->work_cond);
+        ff_cond_broadcast(&w->done_cond);
+    }
+    ff_mutex_unlock(&w->lock);
+
+    return NULL;
+}
+#endif
+
+int ff_segment_writer_alloc(SegmentWriter **pw, AVFormatContext *s,
+                            int nb_threads, int max_pending)
+{
+#if HAVE_THREADS
+    SegmentWriter *w;
+    int ret;
+
+    *pw = NULL;
+    if (nb_threads <= 0 || max_pending <= 0)
+        return AVERROR(EINVAL);
+
+    w = av_mallocz(sizeof(*w));
+    if (!w)
+        return AVERROR(ENOMEM);
+    w->s            = s;
+    w->max_pending  = max_pending;
+    w->pending_tail = &w->pending;
+
+    w->threads = av_calloc(nb_threads, sizeof(*w->threads));
+    if (!w->threads) {
+        av_free(w);
+        return AVERROR(ENOMEM);
+    }
+    if ((ret = ff_mutex_init(&w->lock, NULL))) {
+        av_free(w->threads);
+        av_free(w);
+        return AVERROR(ret);
+    }
+    if ((ret = ff_cond_init(&w->work_cond, NULL))) {
+        ff_mutex_destroy(&w->lock);
+        av_free(w->threads);
+        av_free(w);
+        return AVERROR(ret);
+    }
+    if ((ret = ff_cond_init(&w->done_cond, NULL))) {
+        ff_cond_destroy(&w->work_cond);
+        ff_mutex_destroy(&w->lock);
+        av_free(w->threads);
+        av_free(w);
+        return AVERROR(ret);
+    }
+
+    for (; w->nb_threads < nb_threads; w->nb_threads++) {
+        ret = pthread_create(&w->threads[w->nb_threads], NULL, worker_thread, w);
+        if (ret) {
+            ff_segment_writer_free(&w);
+            return AVERROR(ret);
+        }
+    }
+
+    *pw = w;
+    return 0;
+#else
+    *pw = NULL;
+    return AVERROR(ENOSYS);
+#endif
+}
+
+int ff_segment_writer_flush(SegmentWriter *w)
+{
+    int ret;
+
+    if (!w)
+        return 0;
+
+    ff_mutex_lock(&w->lock);
+    while (w->pending)
+        ff_cond_wait(&w->done_cond, &w->lock);
+    ret = w->error;
+    w->error = 0;
+    ff_mutex_unlock(&w->lock);
+
+    return ret;
+}
+
+int ff_segment_writer_free(SegmentWriter **pw)
+{
+    SegmentWriter *w = *pw;
+    int ret;
+
+    if (!w)
+        return 0;
+
+    while (w->open) {
+        SegmentWriterFile *f = w->open;
+        w->open = f->next;
+        free_file(&f);
+    }
+
+    ff_mutex_lock(&w->lock);
+    w->quit = 1;
+    ff_cond_broadcast(&w->work_cond);
+    ff_mutex_unlock(&w->lock);
+#if HAVE_THREADS
+    for (int i = 0; i < w->nb_threads; i++)
+        pthread_join(w->threads[i], NULL);
+    av_freep(&w->threads);
+#endif
+    ret = w->error;
+
+    ff_cond_destroy(&w->done_cond);
+    ff_cond_destroy(&w->work_cond);
+    ff_mutex_destroy(&w->lock);
+    av_freep(pw);
+
+    return ret;
+}
+
+int ff_segment_writer_open(SegmentWriter *w, AVIOContext **pb, const char *url,
+                           AVDictionary **options)
+{
+    SegmentWriterFile *f = av_mallocz(sizeof(*f));
+    int ret;
+
+    if (!f)
+        return AVERROR(ENOMEM);
+
+    f->url = av_strdup(url);
+    if (!f->url) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    /* encrypted segments are renamed by their plain path */
+    f->path = f->url;
+    av_strstart(f->url, "crypto:", &f->path);
+    f->name = av_strdup(f->path);
+    if (!f->name) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if (options && (ret = av_dict_copy(&f->options, *options, 0)) < 0)
+        goto fail;
+    if ((ret = avio_open_dyn_buf(&f->pb)) < 0)
+        goto fail;
+
+    f->next = w->open;
+    w->open = f;
+    *pb = f->pb;
+    return 0;
+fail:
+    free_file(&f);
+    return ret;
+}
+
+static SegmentWriterFile *take_open_file(SegmentWriter *w, AVIOContext *pb)
+{
+    for (SegmentWriterFile **pf = &w->open; *pf; pf = &(*pf)->next) {
+        SegmentWriterFile *f = *pf;
+        if (f->pb == pb) {
+            *pf = f->next;
+            f->next = NULL;
+            return f;
+        }
+    }
+    return NULL;
+}
+
+int ff_segment_writer_close(SegmentWriter *w, AVIOContext **pb, int flags)
+{
+    SegmentWriterFile *f;
+    int ret;
+
+    if (!*pb)
+        return 0;
+    if (!w || !(f = take_open_file(w, *pb)))
+        return AVERROR(EINVAL);
+
+    *pb = NULL;
+    f->size = avio_close_dyn_buf(f->pb, &f->data);
+    f->pb = NULL;
+    if (f->size < 0) {
+        ret = f->size;
+        free_file(&f);
+        return ret;
+    }
+    f->flags = flags;
+
+    ff_mutex_lock(&w->lock);
+    while (w->nb_pending >= w->max_pending)
+        ff_cond_wait(&w->done_cond, &w->lock);
+    *w->pending_tail = f;
+    w->pending_tail  = &f->next;
+    w->nb_pending++;
+    ff_cond_broadcast(&w->work_cond);
+    ff_mutex_unlock(&w->lock);
+
+    return 0;
+}
+
+void ff_segment_writer_discard(SegmentWriter *w, AVIOContext **pb)
+{
+    SegmentWriterFile *f;
+
+    if (!w || !*pb || !(f = take_open_file(w, *pb)))
+        return;
+    *pb = NULL;
+    free_file(&f);
+}
+
+/* Skip the parts of a local path which do not change the file it names. */
+static const char *file_name(const char *url)
+{
+    av_strstart(url, "file:", &url);
+    while (av_strstart(url, "./", &url))
+        ;
+    return url;
+}
+
+void ff_segment_writer_wait(SegmentWriter *w, const char *url)
+{
+    const char *name;
+    int pending;
+
+    if (!w)
+        return;
+
+    name = file_name(url);
+    ff_mutex_lock(&w->lock);
+    do {
+        pending = 0;
+        for (SegmentWriterFile *f = w->pending; f && !pending; f = f->next)
+            pending = !strcmp(file_name(f->name), name) ||
+                      !strcmp(file_name(f->path), name);
+        if (pending)
+            ff_cond_wait(&w->done_cond, &w->lock);
+    } while (pending);
+    ff_mutex_unlock(&w->lock);
+}
+
+int ff_segment_writer_error(SegmentWriter *w)
+{
+    int ret;
+
+    if (!w)
+        return 0;
+
+    ff_mutex_lock(&w->lock);
+    ret = w->error;
+    w->error = 0;
+    ff_mutex_unlock(&w->lock);
+
+    return ret;
+}
+
+int ff_segment_writer_rename(SegmentWriter *w, const char *url_src,
+                             const char *url_dst, void *logctx)
+{
+    SegmentWriterFile *last = NULL;
+
+    if (w) {
+        ff_mutex_lock(&w->lock);
+        for (SegmentWriterFile *f = w->pending; f; f = f->next)
+            if (!strcmp(f->name, url_src))
+                last = f;
+        if (last) {
+            char *name = av_strdup(url_dst);
+            if (name) {
+                av_free(last->name);
+                last->name = name;
+            }
+            ff_mutex_unlock(&w->lock);
+            return name ? 0 : AVERROR(ENOMEM);
+        }
+        ff_mutex_unlock(&w->lock);
+    }
+
+    return ff_rename(url_src, url_dst, logctx);
+}
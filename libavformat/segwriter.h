@@ -0,0 +1,116 @@
+/*
+ * Background writer for segmenting muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_SEGWRITER_H
+#define AVFORMAT_SEGWRITER_H
+
+#include "libavutil/dict.h"
+
+#include "avformat.h"
+#include "avio.h"
+
+/**
+ * The file may only be written once all files closed before it have been
+ * written. Files closed after it are not held back by it. Used for
+ * playlists and manifests, which reference the segments written before them.
+ */
+#define FF_SEGMENT_WRITE_ORDERED 1
+
+/**
+ * Writes whole files on background threads. Files are buffered in memory
+ * between ff_segment_writer_open() and ff_segment_writer_close(), then
+ * opened with AVFormatContext.io_open, written and closed by one of the
+ * worker threads, so io_open and io_close2 must be thread safe.
+ */
+typedef struct SegmentWriter SegmentWriter;
+
+/**
+ * @param s            muxer the files are written for, used for io_open,
+ *                     io_close2 and logging
+ * @param nb_threads   number of worker threads
+ * @param max_pending  maximum number of files closed but not yet written,
+ *                     ff_segment_writer_close() blocks when it is reached
+ * @return 0 on success, AVERROR(ENOSYS) if threads are not available,
+ *         another negative AVERROR on failure
+ */
+int ff_segment_writer_alloc(SegmentWriter **pw, AVFormatContext *s,
+                            int nb_threads, int max_pending);
+
+/**
+ * Wait for all pending files, stop the worker threads and free the writer.
+ * Files still open are discarded.
+ *
+ * @return the first error of a file which was not reported yet, 0 otherwise
+ */
+int ff_segment_writer_free(SegmentWriter **pw);
+
+/**
+ * Open a memory buffer for a file to be written by the writer.
+ *
+ * @param options options passed to io_open once the file is written, the
+ *                entries are copied
+ */
+int ff_segment_writer_open(SegmentWriter *w, AVIOContext **pb, const char *url,
+                           AVDictionary **options);
+
+/**
+ * Hand a file opened with ff_segment_writer_open() over to the worker threads.
+ * Errors writing it are reported later by ff_segment_writer_error(),
+ * ff_segment_writer_flush() or ff_segment_writer_free().
+ *
+ * @param flags combination of FF_SEGMENT_WRITE_* flags
+ * @return 0 on success, a negative AVERROR if the file could not be queued
+ */
+int ff_segment_writer_close(SegmentWriter *w, AVIOContext **pb, int flags);
+
+/**
+ * Free *pb if it was opened with ff_segment_writer_open(), without writing
+ * it. Does nothing for other contexts or if w is NULL.
+ */
+void ff_segment_writer_discard(SegmentWriter *w, AVIOContext **pb);
+
+/**
+ * Rename a file once it has been written. If no write of url_src is pending
+ * or w is NULL the file is renamed immediately with ff_rename().
+ */
+int ff_segment_writer_rename(SegmentWriter *w, const char *url_src,
+                             const char *url_dst, void *logctx);
+
+/**
+ * Wait until no write of url is pending, e.g. before deleting the file.
+ * url is compared to the name of the file after renames. Does nothing if w
+ * is NULL.
+ */
+void ff_segment_writer_wait(SegmentWriter *w, const char *url);
+
+/**
+ * @return the first error of a file written in the background which was not
+ *         reported yet, 0 otherwise or if w is NULL
+ */
+int ff_segment_writer_error(SegmentWriter *w);
+
+/**
+ * Wait until all files closed so far have been written.
+ *
+ * @return the first error of a file which was not reported yet, 0 otherwise
+ */
+int ff_segment_writer_flush(SegmentWriter *w);
+
+#endif /* AVFORMAT_SEGWRITER_H */
@@ -0,0 +1,206 @@
+/*
+ * AVIOContext read buffering test
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Reads a buffer through an AVIOContext with a pseudo-random mix of small
+ * and large reads, skips and seeks, once with the growth of sequential
+ * reads and once without it, and checks every byte read against the
+ * source. The protocol returns short reads of varying sizes.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/crc.h"
+#include "libavutil/error.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+
+#include "libavformat/avio.h"
+
+#define DATA_SIZE   (4 << 20)
+#define BUFFER_SIZE 32768
+#define NB_OPS      20000
+
+typedef struct Source {
+    uint8_t *data;
+    int64_t pos;
+    int nb_reads;
+    int max_read;
+    int nb_seeks;
+} Source;
+
+static int read_cb(void *opaque, uint8_t *buf, int size)
+{
+    Source *src = opaque;
+
+    src->max_read = FFMAX(src->max_read, size);
+    size = FFMIN(size, 1 + src->nb_reads * 7919 % 100000);
+    src->nb_reads++;
+    size = FFMIN(size, DATA_SIZE - src->pos);
+    if (size <= 0)
+        return AVERROR_EOF;
+    memcpy(buf, src->data + src->pos, size);
+    src->pos += size;
+    return size;
+}
+
+static int64_t seek_cb(void *opaque, int64_t offset, int whence)
+{
+    Source *src = opaque;
+
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+        return DATA_SIZE;
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        offset += src->pos;
+        break;
+    case SEEK_END:
+        offset += DATA_SIZE;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (offset < 0 || offset > DATA_SIZE)
+        return AVERROR(EINVAL);
+    src->nb_seeks++;
+    return src->pos = offset;
+}
+
+/**
+ * Checks that the bytes read at pos match the source.
+ */
+static int check(const Source *src, int64_t pos, const uint8_t *buf, int size,
+                 uint32_t *crc)
+{
+    if (size < 0 || pos + size > DATA_SIZE || memcmp(buf, src->data + pos, size)) {
+        fprintf(stderr, "%d bytes at %"PRId64" do not match the source\n", size, pos);
+        return AVERROR_INVALIDDATA;
+    }
+    *crc = av_crc(av_crc_get_table(AV_CRC_32_IEEE_LE), *crc, buf, size);
+    return 0;
+}
+
+static int read_all(Source *src, int grow, uint32_t *crc_out)
+{
+    AVIOContext *pb;
+    uint8_t *iobuf = av_malloc(BUFFER_SIZE);
+    uint8_t *buf   = av_malloc(100000);
+    uint32_t crc = 0, r = 1;
+    int ret = 0;
+
+    src->pos = src->nb_reads = src->max_read = src->nb_seeks = 0;
+    if (!iobuf || !buf ||
+        !(pb = avio_alloc_context(iobuf, BUFFER_SIZE, 0, src, read_cb, NULL, seek_cb))) {
+        av_free(iobuf);
+        av_free(buf);
+        return AVERROR(ENOMEM);
+    }
+    /* a maximum packet size disables the growth of the reads */
+    if (!grow)
+        pb->max_packet_size = BUFFER_SIZE;
+
+    for (int i = 0; i < NB_OPS && ret >= 0; i++) {
+        int64_t pos = avio_tell(pb);
+        int size;
+
+        r = r * 1664525 + 1013904223;
+        switch (r >> 29) {
+        case 0:
+            buf[0] = avio_r8(pb);
+            ret = check(src, pos, buf, !avio_feof(pb), &crc);
+            break;
+        case 1:
+            AV_WB32(buf, avio_rb32(pb));
+            ret = check(src, pos, buf, avio_feof(pb) ? 0 : 4, &crc);
+            break;
+        case 2:
+        case 3:
+            size = avio_read(pb, buf, (r >> 8) % 2000);
+            ret  = check(src, pos, buf, FFMAX(size, 0), &crc);
+            break;
+        case 4:
+            /* larger than the buffer, read directly */
+            size = avio_read(pb, buf, (r >> 8) % 100000);
+            ret  = check(src, pos, buf, FFMAX(size, 0), &crc);
+            break;
+        case 5:
+            /* seeking past the end fails or stops at EOF depending on the
+             * buffer size, so stay within the input */
+            avio_skip(pb, FFMIN((r >> 8) % 5000, DATA_SIZE - pos));
+            break;
+        case 6:
+            avio_seek(pb, FFMAX(pos - (int)((r >> 8) % 3000), 0), SEEK_SET);
+            break;
+        case 7:
+            if (!(r & 0xf00))
+                avio_seek(pb, (r >> 8) % DATA_SIZE, SEEK_SET);
+            else if (avio_feof(pb))
+                avio_seek(pb, 0, SEEK_SET);
+            break;
+        }
+    }
+    /* then everything left sequentially */
+    while (ret >= 0 && !avio_feof(pb)) {
+        int64_t pos = avio_tell(pb);
+        int size = avio_read(pb, buf, 1000);
+
+        ret = check(src, pos, buf, FFMAX(size, 0), &crc);
+    }
+    if (ret >= 0 && avio_tell(pb) != DATA_SIZE) {
+        fprintf(stderr, "stopped at %"PRId64"\n", avio_tell(pb));
+        ret = AVERROR_INVALIDDATA;
+    }
+
+    if (ret >= 0) {
+        *crc_out = crc;
+        printf("growth %-3s: %5d reads, largest %6d, %3d seeks, crc 0x%08"PRIx32"\n",
+               grow ? "on" : "off", src->nb_reads, src->max_read, src->nb_seeks, crc);
+    }
+
+    av_freep(&pb->buffer);
+    avio_context_free(&pb);
+    av_free(buf);
+    return ret;
+}
+
+int main(void)
+{
+    Source src = { av_malloc(DATA_SIZE) };
+    uint32_t crc[2], r = 0;
+    int ret = 1;
+
+    if (!src.data)
+        return 1;
+    for (int i = 0; i < DATA_SIZE; i++) {
+        r = r * 1103515245 + 12345;
+        src.data[i] = r >> 16;
+    }
+
+    if (read_all(&src, 1, &crc[0]) >= 0 && read_all(&src, 0, &crc[1]) >= 0)
+        ret = crc[0] != crc[1];
+
+    av_free(src.data);
+    return ret;
+}
@@ -0,0 +1,263 @@
+/*
+ * MOV demuxer edit list test
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Muxes a variable frame rate video track without composition offsets
+ * into an MP4 file in memory, with edit lists that trim the end of the
+ * track, and prints the packets the demuxer returns for it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/intreadwrite.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+
+#include "libavformat/avformat.h"
+
+#define NB_FRAMES 50
+
+typedef struct Buffer {
+    uint8_t *data;
+    int64_t size;
+    int64_t pos;
+} Buffer;
+
+typedef struct TestConfig {
+    const char *name;
+    int64_t first_dts;      ///< a positive value makes the muxer write two edits
+    int nb_discarded;       ///< frames at the end excluded from the edit list
+    uint32_t edits[2][2];   ///< if set, replaces the edits: duration, media time
+} TestConfig;
+
+static const TestConfig configs[] = {
+    { "trim-end",  0,   12 },
+    { "two-edits", 512,  0, { { 5120, 0 }, { 12800, 10240 } } },
+};
+
+static int write_cb(void *opaque, const uint8_t *buf, int size)
+{
+    Buffer *b = opaque;
+
+    if (b->pos + size > b->size) {
+        void *data = av_realloc(b->data, b->pos + size);
+        if (!data)
+            return AVERROR(ENOMEM);
+        b->data = data;
+        b->size = b->pos + size;
+    }
+    memcpy(b->data + b->pos, buf, size);
+    b->pos += size;
+    return size;
+}
+
+static int read_cb(void *opaque, uint8_t *buf, int size)
+{
+    Buffer *b = opaque;
+
+    size = FFMIN(size, b->size - b->pos);
+    if (size <= 0)
+        return AVERROR_EOF;
+    memcpy(buf, b->data + b->pos, size);
+    b->pos += size;
+    return size;
+}
+
+static int64_t seek_cb(void *opaque, int64_t offset, int whence)
+{
+    Buffer *b = opaque;
+
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+        return b->size;
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        offset += b->pos;
+        break;
+    case SEEK_END:
+        offset += b->size;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (offset < 0 || offset > b->size)
+        return AVERROR(EINVAL);
+    return b->pos = offset;
+}
+
+static int mux(const TestConfig *cfg, Buffer *b)
+{
+    AVFormatContext *s = NULL;
+    AVPacket *pkt = NULL;
+    AVStream *st;
+    uint8_t *iobuf = NULL;
+    int64_t dts = cfg->first_dts;
+    int ret;
+
+    ret = avformat_alloc_output_context2(&s, NULL, "mp4", NULL);
+    if (ret < 0)
+        return ret;
+    s->flags |= AVFMT_FLAG_BITEXACT;
+
+    iobuf = av_malloc(32768);
+    pkt   = av_packet_alloc();
+    if (!iobuf || !pkt) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    s->pb = avio_alloc_context(iobuf, 32768, 1, b, NULL, write_cb, seek_cb);
+    if (!s->pb) {
+        av_free(iobuf);
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    if (!(st = avformat_new_stream(s, NULL))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    st->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+    st->codecpar->codec_id   = AV_CODEC_ID_MPEG4;
+    st->codecpar->width      = 64;
+    st->codecpar->height     = 64;
+    st->time_base            = (AVRational){ 1, 12800 };
+
+    if ((ret = avformat_write_header(s, NULL)) < 0)
+        goto end;
+
+    /* 25 frames at 25 fps, then 25 frames at 12.5 fps */
+    for (int frame = 0; frame < NB_FRAMES; frame++) {
+        if ((ret = av_new_packet(pkt, 100 + frame)) < 0)
+            goto end;
+        memset(pkt->data, frame, pkt->size);
+        pkt->dts = pkt->pts = dts;
+        pkt->duration = frame < 25 ? 512 : 1024;
+        pkt->flags    = frame % 10 ? 0 : AV_PKT_FLAG_KEY;
+        if (frame >= NB_FRAMES - cfg->nb_discarded)
+            pkt->flags |= AV_PKT_FLAG_DISCARD;
+        dts += pkt->duration;
+        if ((ret = av_write_frame(s, pkt)) < 0)
+            goto end;
+        av_packet_unref(pkt);
+    }
+    ret = av_write_trailer(s);
+
+end:
+    av_packet_free(&pkt);
+    if (s && s->pb) {
+        avio_flush(s->pb);
+        av_freep(&s->pb->buffer);
+        avio_context_free(&s->pb);
+    }
+    avformat_free_context(s);
+    return ret;
+}
+
+/* overwrite the entries of the version 0 edit list written by the muxer */
+static int replace_edits(const TestConfig *cfg, Buffer *b)
+{
+    for (int64_t i = 4; i + 8 + 2 * 12 <= b->size; i++) {
+        uint8_t *elst = b->data + i;
+
+        if (memcmp(elst, "elst", 4) || AV_RB32(elst - 4) != 16 + 2 * 12 ||
+            elst[4] || AV_RB32(elst + 8) != 2)
+            continue;
+        for (int j = 0; j < 2; j++) {
+            AV_WB32(elst + 12 + 12 * j,     cfg->edits[j][0]);
+            AV_WB32(elst + 12 + 12 * j + 4, cfg->edits[j][1]);
+        }
+        return 0;
+    }
+    return AVERROR_BUG;
+}
+
+static int demux(Buffer *b)
+{
+    AVFormatContext *s = NULL;
+    AVIOContext *pb = NULL;
+    AVPacket *pkt = NULL;
+    uint8_t *iobuf = NULL;
+    int ret;
+
+    b->pos = 0;
+    s      = avformat_alloc_context();
+    iobuf  = av_malloc(4096);
+    pkt    = av_packet_alloc();
+    if (!s || !iobuf || !pkt) {
+        av_free(iobuf);
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    s->pb = pb = avio_alloc_context(iobuf, 4096, 0, b, read_cb, NULL, seek_cb);
+    if (!pb) {
+        av_free(iobuf);
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    ret = avformat_open_input(&s, NULL, av_find_input_format("mov"), NULL);
+    if (ret < 0)
+        goto end;
+
+    while ((ret = av_read_frame(s, pkt)) >= 0) {
+        printf("pts %6"PRId64" dts %6"PRId64" duration %4"PRId64" size %3d%s%s\n",
+               pkt->pts, pkt->dts, pkt->duration, pkt->size,
+               pkt->flags & AV_PKT_FLAG_KEY     ? " key"     : "",
+               pkt->flags & AV_PKT_FLAG_DISCARD ? " discard" : "");
+        av_packet_unref(pkt);
+    }
+    if (ret == AVERROR_EOF)
+        ret = 0;
+
+end:
+    av_packet_free(&pkt);
+    avformat_close_input(&s);
+    if (pb) {
+        av_freep(&pb->buffer);
+        avio_context_free(&pb);
+    }
+    return ret;
+}
+
+int main(void)
+{
+    int ret;
+
+    av_log_set_level(AV_LOG_ERROR);
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(configs); i++) {
+        const TestConfig *cfg = &configs[i];
+        Buffer b = { 0 };
+
+        printf("%s\n", cfg->name);
+        if ((ret = mux(cfg, &b)) < 0 ||
+            cfg->edits[0][0] && (ret = replace_edits(cfg, &b)) < 0 ||
+            (ret = demux(&b)) < 0) {
+            fprintf(stderr, "%s: %s\n", cfg->name, av_err2str(ret));
+            av_free(b.data);
+            return 1;
+        }
+        av_free(b.data);
+    }
+
+    return 0;
+}
@@ -0,0 +1,231 @@
+/*
+ * MPEG-TS muxer packetization test and benchmark
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Muxes synthetic multi-program streams and prints the size and MD5 of the
+ * output. With "-b" a larger stream is muxed repeatedly and the packetization
+ * throughput is printed instead.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/channel_layout.h"
+#include "libavutil/dict.h"
+#include "libavutil/hash.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#include "libavformat/avformat.h"
+
+typedef struct TestConfig {
+    const char *name;
+    int nb_programs;
+    const char *options;
+} TestConfig;
+
+static const TestConfig configs[] = {
+    { "vbr",  3, "" },
+    { "cbr",  3, "muxrate=120000000" },
+    { "m2ts", 1, "mpegts_m2ts_mode=1:muxrate=40000000" },
+    { "pes",  3, "pes_payload_size=0:mpegts_flags=+resend_headers+pat_pmt_at_frames" },
+};
+
+typedef struct Output {
+    struct AVHashContext *hash;
+    int64_t size;
+} Output;
+
+static int write_cb(void *opaque, const uint8_t *buf, int size)
+{
+    Output *out = opaque;
+
+    if (out->hash)
+        av_hash_update(out->hash, buf, size);
+    out->size += size;
+    return size;
+}
+
+/* packet payloads are taken from a pseudo-random pool, so that generating
+ * them does not show up in the benchmark */
+#define POOL_SIZE (1 << 20)
+static uint8_t pool[POOL_SIZE];
+
+static void fill_pool(void)
+{
+    unsigned seed = 1;
+
+    for (int i = 0; i < POOL_SIZE; i++) {
+        seed    = seed * 1664525 + 1013904223;
+        pool[i] = seed >> 24;
+    }
+}
+
+static void fill_payload(uint8_t *data, int size, unsigned seed)
+{
+    memcpy(data, pool + seed * 4099LL % (POOL_SIZE - size), size);
+}
+
+static int mux(const TestConfig *cfg, int nb_frames, int video_size,
+               Output *out)
+{
+    AVFormatContext *s = NULL;
+    AVDictionary *opts = NULL;
+    AVPacket *pkt = NULL;
+    uint8_t *iobuf = NULL;
+    int ret;
+
+    ret = avformat_alloc_output_context2(&s, NULL, "mpegts", NULL);
+    if (ret < 0)
+        return ret;
+    s->flags    |= AVFMT_FLAG_BITEXACT;
+    s->max_delay = 700000;
+
+    iobuf = av_malloc(32768);
+    pkt   = av_packet_alloc();
+    if (!iobuf || !pkt) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    s->pb = avio_alloc_context(iobuf, 32768, 1, out, NULL, write_cb, NULL);
+    if (!s->pb) {
+        av_free(iobuf);
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    for (int i = 0; i < cfg->nb_programs; i++) {
+        AVProgram *program = av_new_program(s, i + 1);
+        AVStream *video    = avformat_new_stream(s, NULL);
+        AVStream *audio    = avformat_new_stream(s, NULL);
+
+        if (!program || !video || !audio) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        video->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+        video->codecpar->codec_id   = AV_CODEC_ID_MPEG2VIDEO;
+        video->codecpar->width      = 1920;
+        video->codecpar->height     = 1080;
+        video->time_base            = (AVRational){ 1, 90000 };
+        audio->codecpar->codec_type  = AVMEDIA_TYPE_AUDIO;
+        audio->codecpar->codec_id    = AV_CODEC_ID_MP2;
+        audio->codecpar->sample_rate = 48000;
+        audio->codecpar->ch_layout   = (AVChannelLayout)AV_CHANNEL_LAYOUT_STEREO;
+        audio->time_base             = (AVRational){ 1, 90000 };
+        av_program_add_stream_index(s, program->id, video->index);
+        av_program_add_stream_index(s, program->id, audio->index);
+    }
+
+    if ((ret = av_dict_parse_string(&opts, cfg->options, "=", ":", 0)) < 0)
+        goto end;
+    if ((ret = avformat_write_header(s, &opts)) < 0)
+        goto end;
+
+    /* 25 fps video and 24 ms audio frames, interleaved by dts */
+    for (int frame = 0; frame < nb_frames; frame++) {
+        int64_t video_dts = frame * 3600LL;
+
+        for (int i = 0; i < cfg->nb_programs; i++) {
+            int size = video_size + ((frame * 7919 + i * 104729) % 4096);
+
+            if ((ret = av_new_packet(pkt, size)) < 0)
+                goto end;
+            fill_payload(pkt->data, size, frame * cfg->nb_programs + i);
+            pkt->stream_index = 2 * i;
+            pkt->dts   = video_dts + 3600;
+            pkt->pts   = video_dts + 3600 * (frame % 3 ? 1 : 3);
+            pkt->flags = frame % 25 ? 0 : AV_PKT_FLAG_KEY;
+            if ((ret = av_write_frame(s, pkt)) < 0)
+                goto end;
+            av_packet_unref(pkt);
+        }
+        for (int64_t audio_dts = (video_dts + 2159) / 2160 * 2160;
+             audio_dts < video_dts + 3600; audio_dts += 2160) {
+            for (int i = 0; i < cfg->nb_programs; i++) {
+                if ((ret = av_new_packet(pkt, 576)) < 0)
+                    goto end;
+                fill_payload(pkt->data, 576, audio_dts + i);
+                pkt->stream_index = 2 * i + 1;
+                pkt->dts   = pkt->pts = audio_dts + 3600;
+                pkt->flags = AV_PKT_FLAG_KEY;
+                if ((ret = av_write_frame(s, pkt)) < 0)
+                    goto end;
+                av_packet_unref(pkt);
+            }
+        }
+    }
+    ret = av_write_trailer(s);
+
+end:
+    av_dict_free(&opts);
+    av_packet_free(&pkt);
+    if (s && s->pb) {
+        avio_flush(s->pb);
+        av_freep(&s->pb->buffer);
+        avio_context_free(&s->pb);
+    }
+    avformat_free_context(s);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int bench = argc > 1 && !strcmp(argv[1], "-b");
+    int ret;
+
+    av_log_set_level(AV_LOG_ERROR);
+    fill_pool();
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(configs); i++) {
+        const TestConfig *cfg = &configs[i];
+        Output out = { 0 };
+
+        if (bench) {
+            int64_t t = av_gettime_relative();
+            for (int run = 0; run < 10; run++) {
+                if ((ret = mux(cfg, 250, 160000, &out)) < 0)
+                    goto fail;
+            }
+            t = av_gettime_relative() - t;
+            printf("%-5s %8.1f MB/s\n", cfg->name,
+                   out.size / (double)FFMAX(t, 1));
+        } else {
+            uint8_t digest[AV_HASH_MAX_SIZE * 2 + 1];
+
+            if ((ret = av_hash_alloc(&out.hash, "md5")) < 0)
+                goto fail;
+            av_hash_init(out.hash);
+            ret = mux(cfg, 25, 20000, &out);
+            av_hash_final_hex(out.hash, digest, sizeof(digest));
+            av_hash_freep(&out.hash);
+            if (ret < 0)
+                goto fail;
+            printf("%-5s %9"PRId64" %s\n", cfg->name, out.size, digest);
+        }
+        continue;
+fail:
+        fprintf(stderr, "%s: %s\n", cfg->name, av_err2str(ret));
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,359 @@
+/*
+ * MXF demuxer growing file test
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Muxes synthetic MPEG-2 frames into an MXF file in memory, the way a
+ * non-seekable output is written, then demuxes it once complete and once
+ * with the growing option while the file grows by a few KiB every time its
+ * size is queried. The packets and the timestamps found in the index must
+ * match.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/dict.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixfmt.h"
+
+#include "libavformat/avformat.h"
+
+#define NB_FRAMES  1104
+#define GOP_SIZE     12
+#define GROW_STEP  5000
+
+typedef struct Buffer {
+    uint8_t *data;
+    int64_t size;       ///< size visible to the demuxer
+    int64_t full_size;
+    int64_t pos;
+    int grow;
+} Buffer;
+
+typedef struct Packet {
+    int64_t pts, dts, pos;
+    int size;
+} Packet;
+
+static int write_cb(void *opaque, const uint8_t *buf, int size)
+{
+    Buffer *b = opaque;
+    void *data = av_realloc(b->data, b->full_size + size);
+
+    if (!data)
+        return AVERROR(ENOMEM);
+    b->data = data;
+    memcpy(b->data + b->full_size, buf, size);
+    b->full_size += size;
+    return size;
+}
+
+static int read_cb(void *opaque, uint8_t *buf, int size)
+{
+    Buffer *b = opaque;
+
+    size = FFMIN(size, b->size - b->pos);
+    if (size <= 0)
+        return AVERROR_EOF;
+    memcpy(buf, b->data + b->pos, size);
+    b->pos += size;
+    return size;
+}
+
+static int64_t seek_cb(void *opaque, int64_t offset, int whence)
+{
+    Buffer *b = opaque;
+
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+        if (b->grow)
+            b->size = FFMIN(b->size + GROW_STEP, b->full_size);
+        return b->size;
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        offset += b->pos;
+        break;
+    case SEEK_END:
+        offset += b->size;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (offset < 0 || offset > b->size)
+        return AVERROR(EINVAL);
+    return b->pos = offset;
+}
+
+/* sequence header, sequence extension and GOP header of a 720x576 MP@ML
+ * stream at 25 fps, followed by a picture header */
+static int write_frame(uint8_t *data, int frame)
+{
+    static const uint8_t seq[] = {
+        0x00, 0x00, 0x01, 0xb3, 0x2d, 0x02, 0x40, 0x23, 0xff, 0xff, 0xe0, 0x18,
+        0x00, 0x00, 0x01, 0xb5, 0x14, 0x8a, 0x00, 0x01, 0x00, 0x00,
+        0x00, 0x00, 0x01, 0xb8, 0x00, 0x08, 0x00, 0x00,
+    };
+    /* stored order I2 B0 B1 P5 B3 B4 ... */
+    int n = frame % GOP_SIZE;
+    int temporal_ref = n % 3 ? n - 1 : n + 2;
+    int type = !n ? 1 : n % 3 ? 3 : 2;
+    int size = 0;
+
+    if (!n) {
+        memcpy(data, seq, sizeof(seq));
+        size = sizeof(seq);
+    }
+    data[size++] = 0x00;
+    data[size++] = 0x00;
+    data[size++] = 0x01;
+    data[size++] = 0x00;
+    data[size++] = temporal_ref >> 2;
+    data[size++] = (temporal_ref & 3) << 6 | type << 3;
+    data[size++] = 0x00;
+    data[size++] = 0x00;
+    data[size++] = 0x01;
+    data[size++] = 0xb5;
+    data[size++] = 0x8f;
+    data[size++] = 0xff;
+    data[size++] = 0xf3;
+    data[size++] = 0x41;
+    data[size++] = 0x80;
+    /* no start codes in the payload */
+    for (int end = size + 1000 + frame * 7919 % 2000; size < end; size++)
+        data[size] = (size + frame) % 255 + 1;
+    return size;
+}
+
+static int mux(Buffer *b)
+{
+    AVFormatContext *s = NULL;
+    AVPacket *pkt = NULL;
+    AVStream *st;
+    uint8_t *iobuf = NULL;
+    int ret;
+
+    ret = avformat_alloc_output_context2(&s, NULL, "mxf", NULL);
+    if (ret < 0)
+        return ret;
+    s->flags |= AVFMT_FLAG_BITEXACT;
+
+    iobuf = av_malloc(32768);
+    pkt   = av_packet_alloc();
+    if (!iobuf || !pkt) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    s->pb = avio_alloc_context(iobuf, 32768, 1, b, NULL, write_cb, NULL);
+    if (!s->pb) {
+        av_free(iobuf);
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    if (!(st = avformat_new_stream(s, NULL))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    st->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+    st->codecpar->codec_id   = AV_CODEC_ID_MPEG2VIDEO;
+    st->codecpar->width      = 720;
+    st->codecpar->height     = 576;
+    st->codecpar->format     = AV_PIX_FMT_YUV420P;
+    st->time_base            = (AVRational){ 1, 25 };
+    st->avg_frame_rate       = (AVRational){ 25, 1 };
+
+    if ((ret = avformat_write_header(s, NULL)) < 0)
+        goto end;
+
+    for (int frame = 0; frame < NB_FRAMES; frame++) {
+        int n = frame % GOP_SIZE;
+
+        if ((ret = av_new_packet(pkt, 4096)) < 0)
+            goto end;
+        pkt->size  = write_frame(pkt->data, frame);
+        pkt->dts   = frame;
+        pkt->pts   = frame - n + (n % 3 ? n - 1 : n + 2) + 1;
+        pkt->flags = n ? 0 : AV_PKT_FLAG_KEY;
+        if ((ret = av_write_frame(s, pkt)) < 0)
+            goto end;
+        av_packet_unref(pkt);
+    }
+    ret = av_write_trailer(s);
+
+end:
+    av_packet_free(&pkt);
+    if (s && s->pb) {
+        avio_flush(s->pb);
+        av_freep(&s->pb->buffer);
+        avio_context_free(&s->pb);
+    }
+    avformat_free_context(s);
+    return ret;
+}
+
+/**
+ * Reads all packets and stores them, or checks that they match the stored
+ * ones where they have timestamps if check is set.
+ * @return the number of packets with timestamps, <0 on error
+ */
+static int read_packets(AVFormatContext *s, AVPacket *pkt, Packet *packets, int check)
+{
+    int nb_packets = 0, nb_timestamps = 0;
+    int ret;
+
+    while ((ret = av_read_frame(s, pkt)) >= 0) {
+        Packet *p = &packets[nb_packets];
+
+        if (nb_packets == NB_FRAMES) {
+            av_packet_unref(pkt);
+            return AVERROR_INVALIDDATA;
+        }
+        if (!check) {
+            p->pts  = pkt->pts;
+            p->dts  = pkt->dts;
+            p->pos  = pkt->pos;
+            p->size = pkt->size;
+        } else if (p->pos != pkt->pos || p->size != pkt->size ||
+                   pkt->pts != AV_NOPTS_VALUE && (p->pts != pkt->pts || p->dts != pkt->dts)) {
+            fprintf(stderr, "packet %d: pts %"PRId64" dts %"PRId64" pos %"PRId64" size %d, "
+                    "expected pts %"PRId64" dts %"PRId64" pos %"PRId64" size %d\n",
+                    nb_packets, pkt->pts, pkt->dts, pkt->pos, pkt->size,
+                    p->pts, p->dts, p->pos, p->size);
+            av_packet_unref(pkt);
+            return AVERROR_INVALIDDATA;
+        }
+        nb_timestamps += pkt->pts != AV_NOPTS_VALUE;
+        nb_packets++;
+        av_packet_unref(pkt);
+    }
+    if (ret != AVERROR_EOF)
+        return ret;
+    if (nb_packets != NB_FRAMES) {
+        fprintf(stderr, "%d packets, expected %d\n", nb_packets, NB_FRAMES);
+        return AVERROR_INVALIDDATA;
+    }
+    return nb_timestamps;
+}
+
+/**
+ * Demuxes the buffer once complete, or while it grows and again after
+ * seeking back to its start.
+ */
+static int demux(Buffer *b, int grow, Packet *packets)
+{
+    static const uint8_t essence_key[] = {
+        0x06, 0x0e, 0x2b, 0x34, 0x01, 0x02, 0x01, 0x01, 0x0d, 0x01, 0x03, 0x01
+    };
+    AVFormatContext *s = NULL;
+    AVIOContext *pb = NULL;
+    AVDictionary *opts = NULL;
+    AVPacket *pkt = NULL;
+    uint8_t *iobuf = NULL;
+    int ret;
+
+    b->pos  = 0;
+    b->size = b->full_size;
+    b->grow = grow;
+    if (grow) {
+        /* start with the header and the first essence key */
+        for (b->size = 0; b->size < b->full_size - sizeof(essence_key); b->size++)
+            if (!memcmp(b->data + b->size, essence_key, sizeof(essence_key)))
+                break;
+        b->size += 16;
+        av_dict_set(&opts, "growing", "1", 0);
+        av_dict_set(&opts, "growing_timeout", "0", 0);
+    }
+
+    s     = avformat_alloc_context();
+    iobuf = av_malloc(4096);
+    pkt   = av_packet_alloc();
+    if (!s || !iobuf || !pkt) {
+        av_free(iobuf);
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    s->pb = pb = avio_alloc_context(iobuf, 4096, 0, b, read_cb, NULL, seek_cb);
+    if (!pb) {
+        av_free(iobuf);
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    /* only the timestamps derived from the index */
+    s->flags |= AVFMT_FLAG_NOFILLIN;
+
+    ret = avformat_open_input(&s, NULL, av_find_input_format("mxf"), &opts);
+    if (ret < 0)
+        goto end;
+
+    if ((ret = read_packets(s, pkt, packets, grow)) < 0)
+        goto end;
+    if (!grow) {
+        printf("complete: %d packets, %d with timestamps\n", NB_FRAMES, ret);
+        goto end;
+    }
+    /* the index of each partition is written after its essence */
+    printf("growing:  %d packets, %d with timestamps, duration %"PRId64"\n",
+           NB_FRAMES, ret, s->streams[0]->duration);
+
+    if ((ret = av_seek_frame(s, 0, 0, AVSEEK_FLAG_BACKWARD)) < 0 ||
+        (ret = read_packets(s, pkt, packets, 1)) < 0)
+        goto end;
+    printf("rewound:  %d packets, %d with timestamps\n", NB_FRAMES, ret);
+
+end:
+    av_dict_free(&opts);
+    av_packet_free(&pkt);
+    avformat_close_input(&s);
+    if (pb) {
+        av_freep(&pb->buffer);
+        avio_context_free(&pb);
+    }
+    return ret;
+}
+
+int main(void)
+{
+    Buffer b = { 0 };
+    Packet *packets = av_calloc(NB_FRAMES, sizeof(*packets));
+    int ret;
+
+    av_log_set_level(AV_LOG_ERROR);
+
+    if (!packets) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = mux(&b)) < 0 ||
+        (ret = demux(&b, 0, packets)) < 0 ||
+        (ret = demux(&b, 1, packets)) < 0)
+        goto fail;
+
+    av_free(b.data);
+    av_free(packets);
+    return 0;
+
+fail:
+    fprintf(stderr, "%s\n", av_err2str(ret));
+    av_free(b.data);
+    av_free(packets);
+    return 1;
+}
@@ -856,6 +856,13 @@ static int sws_graph_worker(void *priv, int jobnr, int threadnr, int nb_jobs,
 {
     SwsGraph *graph = priv;
     const SwsPass *pass = graph->exec.pass;
+    if (jobnr >= pass->num_slices) {
+        /* slice of the other field, see ff_sws_graph_run_fields() */
+        jobnr -= pass->num_slices;
+        graph  = graph->exec.field;
+        pass   = graph->exec.pass;
+    }
+
     const int slice_y = jobnr * pass->slice_h;
     const int slice_h = FFMIN(pass->slice_h, pass->lines - slice_y);
 
@@ -1023,6 +1030,17 @@ static void get_field(SwsGraph *graph, const SwsFormat *fmt,
     frame->height = (frame->height + (fmt->field == FIELD_TOP)) >> 1;
 }
 
+static int pass_setup(SwsGraph *graph, const SwsPass *pass,
+                      const SwsFrame *dst_field, const SwsFrame *src_field)
+{
+    graph->exec.pass   = pass;
+    graph->exec.input  = pass->input ? &pass->input->output->frame : src_field;
+    graph->exec.output = pass->output->avframe ? &pass->output->frame : dst_field;
+    if (pass->setup)
+        return pass->setup(graph->exec.output, graph->exec.input, pass);
+    return 0;
+}
+
 int ff_sws_graph_run(SwsGraph *graph, const AVFrame *dst, const AVFrame *src)
 {
     av_assert0(dst->format == graph->dst.hw_format || dst->format == graph->dst.format);
@@ -1034,14 +1052,9 @@ int ff_sws_graph_run(SwsGraph *graph, const AVFrame *dst, const AVFrame *src)
 
     for (int i = 0; i < graph->num_passes; i++) {
         const SwsPass *pass = graph->passes[i];
-        graph->exec.pass   = pass;
-        graph->exec.input  = pass->input ? &pass->input->output->frame : &src_field;
-        graph->exec.output = pass->output->avframe ? &pass->output->frame : &dst_field;
-        if (pass->setup) {
-            int ret = pass->setup(graph->exec.output, graph->exec.input, pass);
-            if (ret < 0)
-                return ret;
-        }
+        int ret = pass_setup(graph, pass, &dst_field, &src_field);
+        if (ret < 0)
+            return ret;
 
         if (pass->num_slices == 1) {
             pass->run(graph->exec.output, graph->exec.input, 0, pass->lines, pass);
@@ -1052,3 +1065,53 @@ int ff_sws_graph_run(SwsGraph *graph, const AVFrame *dst, const AVFrame *src)
 
     return 0;
 }
+
+int ff_sws_graph_run_fields(SwsGraph *top, SwsGraph *bot,
+                            const AVFrame *dst, const AVFrame *src)
+{
+    int ret;
+
+    /* Both fields normally build the same chain of passes; if they do not,
+     * or there is nothing to run in parallel, process them in turn. */
+    if (!top->slicethread || top->num_passes != bot->num_passes) {
+        ret = ff_sws_graph_run(top, dst, src);
+        if (ret < 0)
+            return ret;
+        return ff_sws_graph_run(bot, dst, src);
+    }
+
+    av_assert0(dst->format == top->dst.hw_format || dst->format == top->dst.format);
+    av_assert0(src->format == top->src.hw_format || src->format == top->src.format);
+    av_assert0(top->dst.field == FIELD_TOP && bot->dst.field == FIELD_BOTTOM);
+
+    SwsFrame src_top, dst_top, src_bot, dst_bot;
+    get_field(top, &top->dst, dst, &dst_top);
+    get_field(top, &top->src, src, &src_top);
+    get_field(bot, &bot->dst, dst, &dst_bot);
+    get_field(bot, &bot->src, src, &src_bot);
+
+    for (int i = 0; i < top->num_passes; i++) {
+        const SwsPass *pass_top = top->passes[i];
+        const SwsPass *pass_bot = bot->passes[i];
+
+        ret = pass_setup(top, pass_top, &dst_top, &src_top);
+        if (ret < 0)
+            return ret;
+        ret = pass_setup(bot, pass_bot, &dst_bot, &src_bot);
+        if (ret < 0)
+            return ret;
+
+        if (pass_top->num_slices == 1 && pass_bot->num_slices == 1) {
+            pass_top->run(top->exec.output, top->exec.input, 0, pass_top->lines, pass_top);
+            pass_bot->run(bot->exec.output, bot->exec.input, 0, pass_bot->lines, pass_bot);
+            continue;
+        }
+
+        top->exec.field = bot;
+        avpriv_slicethread_execute2(top->slicethread,
+                                    pass_top->num_slices + pass_bot->num_slices, 0);
+        top->exec.field = NULL;
+    }
+
+    return 0;
+}
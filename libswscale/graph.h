@@ -177,6 +177,7 @@ typedef struct SwsGraph {
         const SwsPass *pass; /* current filter pass */
         const SwsFrame *input; /* current filter pass input/output */
         const SwsFrame *output;
+        struct SwsGraph *field; /* other field dispatched in the same job */
     } exec;
 } SwsGraph;
 
@@ -259,4 +260,12 @@ int ff_sws_graph_reinit(SwsGraph *graph, SwsContext *ctx, const SwsFormat *dst,
  */
 int ff_sws_graph_run(SwsGraph *graph, const AVFrame *dst, const AVFrame *src);
 
+/**
+ * Dispatch the filter graphs of both fields of the given frames. Matching
+ * passes of the two fields are executed as one threaded job, so the fields
+ * are processed in parallel rather than one after the other.
+ */
+int ff_sws_graph_run_fields(SwsGraph *top, SwsGraph *bot,
+                            const AVFrame *dst, const AVFrame *src);
+
 #endif /* SWSCALE_GRAPH_H */
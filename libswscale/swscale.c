@@ -1289,7 +1289,7 @@ static int frame_alloc_buffers(SwsContext *sws, AVFrame *frame)
 
         const int idx = buf_start + nb_bufs++;
         av_assert1(idx < FF_ARRAY_ELEMS(frame->buf));
-        frame->buf[idx] = av_buffer_pool_get(pool->pools[i]);
+        frame->buf[idx] = ff_frame_pool_get_plane_buffer(pool, i);
         if (!frame->buf[idx]) {
             av_frame_unref(frame);
             return AVERROR(ENOMEM);
@@ -1467,13 +1467,14 @@ int sws_scale_frame(SwsContext *sws, AVFrame *dst, const AVFrame *src)
         allocated = 1;
 
 process_frame:
-    for (int field = 0; field < (bot ? 2 : 1); field++) {
-        ret = ff_sws_graph_run(c->graph[field], dst, src);
-        if (ret < 0) {
-            if (allocated)
-                av_frame_unref(dst);
-            return ret;
-        }
+    if (bot)
+        ret = ff_sws_graph_run_fields(c->graph[FIELD_TOP], c->graph[FIELD_BOTTOM], dst, src);
+    else
+        ret = ff_sws_graph_run(c->graph[FIELD_TOP], dst, src);
+    if (ret < 0) {
+        if (allocated)
+            av_frame_unref(dst);
+        return ret;
     }
 
     return 0;
@@ -1610,7 +1611,7 @@ int sws_frame_setup(SwsContext *ctx, const AVFrame *dst, const AVFrame *src)
     }
 
     if (!dst->hw_frames_ctx) {
-        ret = ff_frame_pool_video_reinit(&s->frame_pool, dst_width, dst->height,
+        ret = ff_frame_pool_video_reinit(&s->frame_pool, NULL, dst_width, dst->height,
                                          dst->format, av_cpu_max_align());
         if (ret < 0)
             return ret;
@@ -209,6 +209,32 @@ ffprobe_demux(){
         -show_data_hash CRC32 "$filename" "$@"
 }
 
+# Probe a file without a cache, then with the given cache option, once
+# writing and once reading the cache file, and check the output is the same.
+probe_cache(){
+    cache_opt=$1
+    srcfile=$2
+    cache_msg=$3
+    shift 3
+    tsrcfile=$(target_path $srcfile)
+    cachefile="${outdir}/${test}.cache"
+    probefile="${outdir}/${test}.ffprobe"
+    cachedfile="${outdir}/${test}.cached.ffprobe"
+    logfile="${outdir}/${test}.log"
+    cleanfiles="$cleanfiles $cachefile $probefile $cachedfile $logfile"
+    rm -f $cachefile
+    run ffprobe${PROGSUF}${EXECSUF} -bitexact -threads $threads "$@" $tsrcfile > $probefile || return
+    for pass in write read; do
+        run ffprobe${PROGSUF}${EXECSUF} -bitexact -threads $threads -loglevel debug \
+            $cache_opt $(target_path $cachefile) "$@" $tsrcfile > $cachedfile 2> $logfile || return
+        test -f $cachefile || { echo "$pass: no cache file"; return 1; }
+        test $pass = write || grep -q "$cache_msg" $logfile || { echo "$pass: cache not used"; return 1; }
+        diff -u $probefile $cachedfile || return
+        echo "$pass: identical"
+    done
+    cat $probefile
+}
+
 framecrc(){
     ffmpeg "$@" -bitexact -f framecrc -
 }
@@ -15,6 +15,10 @@ $(FFPROBE_OUTPUT_MODES_TESTS): $(FFPROBE_TEST_FILE)
 $(FFPROBE_OUTPUT_MODES_TESTS): CMD = run $(FFPROBE_COMMAND) -of $(@:fate-ffprobe_%=%)
 FFPROBE_TEST_FILE_TESTS-yes += $(FFPROBE_OUTPUT_MODES_TESTS)
 
+FFPROBE_TEST_FILE_TESTS-yes += fate-ffprobe_stream_info_cache
+fate-ffprobe_stream_info_cache: $(FFPROBE_TEST_FILE)
+fate-ffprobe_stream_info_cache: CMD = probe_cache -stream_info_cache $(FFPROBE_TEST_FILE) "Stream parameters restored" -of compact -show_streams -show_format -print_filename $(FFPROBE_TEST_FILE)
+
 FFPROBE_TEST_FILE_TESTS-$(HAVE_XMLLINT) += fate-ffprobe_xsd
 fate-ffprobe_xsd: $(FFPROBE_TEST_FILE)
 fate-ffprobe_xsd: CMD = run $(FFPROBE_COMMAND) -noprivate -of xml=q=1:x=1 | \
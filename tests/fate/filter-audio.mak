@@ -70,6 +70,11 @@ fate-filter-alimiter: tests/data/asynth-44100-2.wav
 fate-filter-alimiter: SRC = $(TARGET_PATH)/tests/data/asynth-44100-2.wav
 fate-filter-alimiter: CMD = framecrc -i $(SRC) -af aresample,alimiter=level_in=1:level_out=2:limit=0.2,aresample
 
+FATE_AFILTER-$(call FILTERDEMDECENCMUX, ALLPASS ARESAMPLE, WAV, PCM_S16LE, PCM_S16LE, WAV) += fate-filter-allpass-cascade
+fate-filter-allpass-cascade: tests/data/asynth-44100-2.wav
+fate-filter-allpass-cascade: SRC = $(TARGET_PATH)/tests/data/asynth-44100-2.wav
+fate-filter-allpass-cascade: CMD = framecrc -i $(SRC) -frames:a 20 -af aresample,allpass=f=1000:cascade=3,aresample
+
 FATE_AFILTER-$(call FILTERDEMDECENCMUX, AMERGE, WAV, PCM_S16LE, PCM_S16LE, WAV) += fate-filter-amerge
 fate-filter-amerge: tests/data/asynth-44100-1.wav
 fate-filter-amerge: SRC = $(TARGET_PATH)/tests/data/asynth-44100-1.wav
@@ -141,6 +146,11 @@ fate-filter-firequalizer: CMP = oneoff
 fate-filter-firequalizer: CMP_UNIT = s16
 fate-filter-firequalizer: SIZE_TOLERANCE = 1058400 - 1097208
 
+FATE_AFILTER-$(call FILTERDEMDECENCMUX, LOWPASS ARESAMPLE, WAV, PCM_S16LE, PCM_S16LE, WAV) += fate-filter-lowpass-cascade
+fate-filter-lowpass-cascade: tests/data/asynth-44100-2.wav
+fate-filter-lowpass-cascade: SRC = $(TARGET_PATH)/tests/data/asynth-44100-2.wav
+fate-filter-lowpass-cascade: CMD = framecrc -i $(SRC) -frames:a 20 -af aresample,lowpass=f=2000:blocksize=512:cascade=2,aresample
+
 FATE_AFILTER-$(call FILTERDEMDECENCMUX, PAN, WAV, PCM_S16LE, PCM_S16LE, WAV) += fate-filter-pan-mono1
 fate-filter-pan-mono1: tests/data/asynth-44100-2.wav
 fate-filter-pan-mono1: SRC = $(TARGET_PATH)/tests/data/asynth-44100-2.wav
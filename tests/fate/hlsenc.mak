@@ -233,6 +233,19 @@ fate-hls-iframes-single-fmp4: tests/data/hls_iframes_single_fmp4.m3u8
 fate-hls-iframes-single-fmp4: CMD = sed -n -e /^\#EXT-X-MAP:/p -e /^\#EXT-X-BYTERANGE:/p $(TARGET_PATH)/tests/data/hls_iframes_single_fmp4.m3u8
 fate-hls-iframes-single-fmp4: CMP = diff
 
+tests/data/hls_write_threads.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+	-f lavfi -i "testsrc2=size=128x72:rate=1:d=5" -f hls -hls_time 1 -map 0:v \
+	-hls_list_size 1 -hls_flags temp_file+delete_segments -c:v mpeg2video -g 1 \
+	-write_threads 2 -max_pending_writes 8 \
+	-hls_segment_filename $(TARGET_PATH)/tests/data/hls_write_threads_%d.ts \
+	$(TARGET_PATH)/tests/data/hls_write_threads.m3u8 2>/dev/null
+
+FATE_HLSENC_LAVFI-$(call ALLYES, TESTSRC2_FILTER LAVFI_INDEV MPEG2VIDEO_ENCODER HLS_MUXER MPEGTS_MUXER FILE_PROTOCOL) += fate-hls-write-threads
+fate-hls-write-threads: tests/data/hls_write_threads.m3u8
+fate-hls-write-threads: CMD = sed -n -e /^\#EXT-X-MEDIA-SEQUENCE:/p -e /^[^\#]/p -e /^\#EXT-X-ENDLIST/p $(TARGET_PATH)/tests/data/hls_write_threads.m3u8; ls $(TARGET_PATH)/tests/data | grep ^hls_write_threads_
+fate-hls-write-threads: CMP = diff
+
 FATE_HLSENC_LAVFI-yes := $(if $(call FRAMECRC), $(FATE_HLSENC_LAVFI-yes))
 
 FATE_FFMPEG += $(FATE_HLSENC_LAVFI-yes)
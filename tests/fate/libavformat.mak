@@ -2,11 +2,27 @@
 #fate-async: libavformat/tests/async$(EXESUF)
 #fate-async: CMD = run libavformat/tests/async
 
+FATE_LIBAVFORMAT += fate-aviobuf
+fate-aviobuf: libavformat/tests/aviobuf$(EXESUF)
+fate-aviobuf: CMD = run libavformat/tests/aviobuf$(EXESUF)
+
 FATE_LIBAVFORMAT += fate-mkdir
 fate-mkdir: libavformat/tests/mkdir$(EXESUF)
 fate-mkdir: CMD = run libavformat/tests/mkdir$(EXESUF)
 fate-mkdir: CMP = null
 
+FATE_LIBAVFORMAT-$(call ALLYES, MP4_MUXER MOV_DEMUXER) += fate-mov_editlist
+fate-mov_editlist: libavformat/tests/mov_editlist$(EXESUF)
+fate-mov_editlist: CMD = run libavformat/tests/mov_editlist$(EXESUF)
+
+FATE_LIBAVFORMAT-$(CONFIG_MPEGTS_MUXER) += fate-mpegtsenc
+fate-mpegtsenc: libavformat/tests/mpegtsenc$(EXESUF)
+fate-mpegtsenc: CMD = run libavformat/tests/mpegtsenc$(EXESUF)
+
+FATE_LIBAVFORMAT-$(call ALLYES, MXF_MUXER MXF_DEMUXER) += fate-mxfdec
+fate-mxfdec: libavformat/tests/mxfdec$(EXESUF)
+fate-mxfdec: CMD = run libavformat/tests/mxfdec$(EXESUF)
+
 FATE_LIBAVFORMAT += fate-rename
 fate-rename: libavformat/tests/rename$(EXESUF)
 fate-rename: CMD = run libavformat/tests/rename$(EXESUF)